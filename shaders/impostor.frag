@@ -0,0 +1,48 @@
+#version 330 core
+out vec4 frag_colour;
+
+in vec2 passTexCoord;
+in vec3 worldPosition;
+in float passFade;
+
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 sunDirection;
+};
+
+// pre-lit views of the object, side by side
+uniform sampler2D atlas;
+
+// fade to the clear colour before the far plane
+const float fog_start = 12;
+const float fog_end = 20;
+
+// must match object.frag, so that the two fades interleave exactly
+float dither() {
+    const float bayer[16] = float[](
+         0,  8,  2, 10,
+        12,  4, 14,  6,
+         3, 11,  1,  9,
+        15,  7, 13,  5);
+    ivec2 p = ivec2(gl_FragCoord.xy) & 3;
+    return (bayer[p.y * 4 + p.x] + 0.5) / 16;
+}
+
+void main() {
+    // covers exactly the pixels the dissolving mesh gives up
+    if (dither() < 1 - passFade)
+        discard;
+
+    frag_colour = texture(atlas, passTexCoord);
+    if (frag_colour.a < 0.5)
+        discard;
+    frag_colour.a = 1;
+
+#ifdef FOG
+    float fog = smoothstep(fog_start, fog_end, distance(worldPosition, cameraPosition.xyz));
+    frag_colour.rgb = mix(frag_colour.rgb, vec3(0), fog);
+#endif
+}
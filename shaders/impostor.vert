@@ -0,0 +1,49 @@
+#version 330 core
+layout (location = 0) in vec3 position; // corner of the billboard, in world units
+layout (location = 2) in vec2 texcoord; // within one view of the atlas
+
+// per instance: where the object stands
+layout (location = 8) in float instanceX;
+layout (location = 9) in float instanceY;
+layout (location = 10) in float instanceZ;
+layout (location = 11) in float instanceFade;
+
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 sunDirection;
+};
+
+// number of views around the atlas, evenly spaced in angle
+uniform int views;
+
+out vec2 passTexCoord;
+out vec3 worldPosition;
+out float passFade;
+
+const float two_pi = 6.28318530718;
+
+void main() {
+    vec3 base = vec3(instanceX, instanceY, instanceZ);
+
+    // turn about the vertical to face the camera
+    vec2 towards = cameraPosition.xz - base.xz;
+    if (dot(towards, towards) < 1e-8)
+        towards = vec2(1, 0);
+    towards = normalize(towards);
+    vec3 right = vec3(towards.y, 0, -towards.x); // as the atlas was baked
+
+    worldPosition = base + right * position.x + vec3(0, position.y, 0);
+    gl_Position = viewProjection * vec4(worldPosition, 1.0);
+
+    // pick the baked view closest to our direction
+    float angle = atan(towards.y, towards.x);
+    int index = int(round(angle / two_pi * views)) % views;
+    if (index < 0)
+        index += views;
+
+    passTexCoord = vec2((texcoord.x + index) / views, texcoord.y);
+    passFade = instanceFade;
+}
@@ -1,11 +1,41 @@
 #version 330 core
 out vec4 frag_colour;
 
-in vec4 colour;
+in vec2 passLight;
 in vec2 passTexCoord;
+in vec3 worldPosition;
+in vec4 passWeights;
 
-uniform sampler2D tex;
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 sunDirection;
+};
+
+// one layer per material; unused layers have zero weight
+uniform sampler2DArray tex;
+
+// share of the light which doesn't come straight from the sun
+const float ambient = 0.3;
+
+// fade to the clear colour before the far plane
+const float fog_start = 12;
+const float fog_end = 20;
 
 void main() {
-    frag_colour = texture(tex, passTexCoord) * colour;
+    // no branching on the weights: that would break the implicit derivatives
+    vec4 albedo = texture(tex, vec3(passTexCoord, 0)) * passWeights.x
+                + texture(tex, vec3(passTexCoord, 1)) * passWeights.y
+                + texture(tex, vec3(passTexCoord, 2)) * passWeights.z
+                + texture(tex, vec3(passTexCoord, 3)) * passWeights.w;
+
+    float light = ambient * passLight.y + (1 - ambient) * passLight.x;
+    frag_colour = vec4(albedo.rgb * light, albedo.a);
+
+#ifdef FOG
+    float fog = smoothstep(fog_start, fog_end, distance(worldPosition, cameraPosition.xyz));
+    frag_colour.rgb = mix(frag_colour.rgb, vec3(0), fog);
+#endif
 }
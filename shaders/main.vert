@@ -2,14 +2,26 @@
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 texcoord;
+layout (location = 3) in vec4 weights;
+layout (location = 4) in vec2 light; // baked sun, ambient occlusion
 
-uniform mat4 modelview;
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 sunDirection;
+};
 
-out vec4 colour;
+out vec2 passLight;
 out vec2 passTexCoord;
+out vec3 worldPosition;
+out vec4 passWeights;
 
 void main() {
-    gl_Position = modelview * vec4(position, 1.0);
-    colour = vec4(position.x / 4, position.z / 20, sin(position.y) / 2 + 0.5, 1);
+    gl_Position = viewProjection * vec4(position, 1.0);
+    passLight = light;
     passTexCoord = texcoord;
+    worldPosition = position;
+    passWeights = weights;
 }
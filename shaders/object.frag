@@ -0,0 +1,44 @@
+#version 330 core
+out vec4 frag_colour;
+
+in vec4 colour;
+in vec3 passNormal;
+in vec3 worldPosition;
+in float passFade;
+
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 sunDirection;
+};
+
+// fade to the clear colour before the far plane
+const float fog_start = 12;
+const float fog_end = 20;
+
+// 4x4 ordered dither, for fading without sorting or blending
+float dither() {
+    const float bayer[16] = float[](
+         0,  8,  2, 10,
+        12,  4, 14,  6,
+         3, 11,  1,  9,
+        15,  7, 13,  5);
+    ivec2 p = ivec2(gl_FragCoord.xy) & 3;
+    return (bayer[p.y * 4 + p.x] + 0.5) / 16;
+}
+
+void main() {
+    // dissolves as the impostor standing in for us appears (see impostor.frag)
+    if (dither() > passFade)
+        discard;
+
+    float diffuse = max(dot(normalize(passNormal), sunDirection.xyz), 0);
+    frag_colour = vec4(colour.rgb * (0.35 + 0.65 * diffuse), colour.a);
+
+#ifdef FOG
+    float fog = smoothstep(fog_start, fog_end, distance(worldPosition, cameraPosition.xyz));
+    frag_colour.rgb = mix(frag_colour.rgb, vec3(0), fog);
+#endif
+}
@@ -0,0 +1,31 @@
+#version 330 core
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 normal;
+layout (location = 3) in vec4 weights; // vertex colour
+
+// per instance: where the object stands
+layout (location = 8) in float instanceX;
+layout (location = 9) in float instanceY;
+layout (location = 10) in float instanceZ;
+layout (location = 11) in float instanceFade;
+
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 sunDirection;
+};
+
+out vec4 colour;
+out vec3 passNormal;
+out vec3 worldPosition;
+out float passFade;
+
+void main() {
+    worldPosition = position + vec3(instanceX, instanceY, instanceZ);
+    gl_Position = viewProjection * vec4(worldPosition, 1.0);
+    colour = weights;
+    passNormal = normal;
+    passFade = instanceFade;
+}
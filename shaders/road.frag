@@ -0,0 +1,37 @@
+#version 330 core
+out vec4 frag_colour;
+
+in vec4 colour;
+in vec3 passNormal;
+in vec2 passTexCoord;
+in vec3 worldPosition;
+
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 sunDirection;
+};
+
+// fade to the clear colour before the far plane
+const float fog_start = 12;
+const float fog_end = 20;
+
+// dashed line down the middle
+const float line_width = 0.06; // of the road's width
+const float dash_length = 0.3; // world units
+
+void main() {
+    vec3 surface = colour.rgb;
+    if (abs(passTexCoord.x - 0.5) < line_width / 2 && fract(passTexCoord.y / (2 * dash_length)) < 0.5)
+        surface = vec3(0.85);
+
+    float diffuse = max(dot(normalize(passNormal), sunDirection.xyz), 0);
+    frag_colour = vec4(surface * (0.35 + 0.65 * diffuse), colour.a);
+
+#ifdef FOG
+    float fog = smoothstep(fog_start, fog_end, distance(worldPosition, cameraPosition.xyz));
+    frag_colour.rgb = mix(frag_colour.rgb, vec3(0), fog);
+#endif
+}
@@ -0,0 +1,31 @@
+#version 330 core
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 normal;
+layout (location = 2) in vec2 texcoord; // across the road, and along it
+layout (location = 3) in vec4 weights;  // surface colour
+
+layout (std140) uniform Frame {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 sunDirection;
+};
+
+// pull towards the camera, so the road always wins against the ground it lies on
+const float depth_offset = 5e-4;
+
+out vec4 colour;
+out vec3 passNormal;
+out vec2 passTexCoord;
+out vec3 worldPosition;
+
+void main() {
+    gl_Position = viewProjection * vec4(position, 1.0);
+    gl_Position.z -= depth_offset * gl_Position.w;
+
+    colour = weights;
+    passNormal = normal;
+    passTexCoord = texcoord;
+    worldPosition = position;
+}
@@ -0,0 +1,87 @@
+#include "alloc_count.h"
+
+#ifdef CHECK_ALLOC
+
+#include <new>
+#include <cstdlib>
+
+namespace {
+
+    thread_local std::size_t count = 0;
+
+    void* allocate(std::size_t size) {
+        ++count;
+        return std::malloc(size ? size : 1);
+    }
+
+    void* allocate(std::size_t size, std::align_val_t alignment) {
+        ++count;
+        // aligned_alloc wants a whole number of alignments
+        const std::size_t align = static_cast<std::size_t>(alignment);
+        return std::aligned_alloc(align, (size + align - 1) / align * align);
+    }
+
+    template <typename... Align>
+    void* allocateOrThrow(std::size_t size, Align... alignment) {
+        if (void* memory = allocate(size, alignment...))
+            return memory;
+        throw std::bad_alloc {};
+    }
+
+} // namespace
+
+namespace world {
+
+std::size_t allocations() {
+    return count;
+}
+
+}
+
+void* operator new(std::size_t size) {
+    return allocateOrThrow(size);
+}
+
+void* operator new[](std::size_t size) {
+    return allocateOrThrow(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return allocateOrThrow(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return allocateOrThrow(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocate(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return allocate(size, alignment);
+}
+
+// everything above comes from malloc, so goes back to free
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete(void* memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept { std::free(memory); }
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept { std::free(memory); }
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef ALLOC_COUNT_H_INCLUDED
+#define ALLOC_COUNT_H_INCLUDED
+
+#include <cstddef>
+
+namespace world {
+
+// Built with CHECK_ALLOC, every form of the global operator new is replaced
+// by one which counts its calls, for --check-alloc. Otherwise nothing is
+// counted, and this is always 0.
+#ifdef CHECK_ALLOC
+constexpr bool counting_allocations = true;
+
+// Allocations made so far by the calling thread
+std::size_t allocations();
+#else
+constexpr bool counting_allocations = false;
+
+inline std::size_t allocations() { return 0; }
+#endif
+
+}
+
+#endif
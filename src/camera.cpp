@@ -8,6 +8,7 @@ namespace world {
 Camera::Camera()
     : clamps { 0, 0 }
     , position { 0, 0, 0 }
+    , previous { 0, 0, 0 }
     , direction { 0, 0, 1 }
     , yaw { 45 }
     , pitch { 0 }
@@ -15,35 +16,9 @@ Camera::Camera()
     updateVectors();
 }
 
-glm::mat4 Camera::getView() const {
-    return glm::lookAt(position, position + direction, up);
-}
-
-void Camera::move(Camera::Direction d, float dt, Camera::altitude_func altitude) {
-    float velocity = move_speed * dt;
-
-    switch (d) {
-        case Direction::Forward:
-            position += direction * velocity;
-            break;
-
-        case Direction::Back:
-            position -= direction * velocity;
-            break;
-
-        case Direction::Right:
-            position += right * velocity;
-            break;
-
-        case Direction::Left:
-            position -= right * velocity;
-            break;
-    }
-
-    position.x = glm::clamp(position.x, 0.f, clamps[0]);
-    position.z = glm::clamp(position.z, 0.f, clamps[1]);
-
-    position.y = altitude(position.x, position.z) + 0.5;
+glm::mat4 Camera::getView(float blend) const {
+    glm::vec3 eye = getPosition(blend);
+    return glm::lookAt(eye, eye + direction, up);
 }
 
 void Camera::tilt(float dx, float dy) {
@@ -56,6 +31,14 @@ void Camera::tilt(float dx, float dy) {
     updateVectors();
 }
 
+void Camera::turnTo(const Camera& other) {
+    yaw = other.yaw;
+    pitch = other.pitch;
+    direction = other.direction;
+    right = other.right;
+    up = other.up;
+}
+
 void Camera::updateVectors() {
     glm::vec3 d = {
         std::cos(glm::radians(yaw)) * std::cos(glm::radians(pitch)),
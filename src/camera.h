@@ -1,37 +1,48 @@
 #ifndef CAMERA_H_INCLUDED
 #define CAMERA_H_INCLUDED
 
+#include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <glm/mat4x4.hpp>
-#include <functional>
+#include <glm/common.hpp>
 
 namespace world {
 
 class Camera {
 public:
-    enum class Direction {
-        Forward,
-        Back,
-        Left,
-        Right,
-    };
-
     Camera();
 
     void setClamps(glm::vec2 clamps) {
         this->clamps = clamps;
     }
 
-    glm::mat4 getView() const;
+    // Views part of the way (`blend', from 0 to 1) from where the camera was
+    // at the last settle() to where it is now. Turning isn't blended.
+    glm::mat4 getView(float blend = 1) const;
+    glm::vec3 getPosition(float blend = 1) const {
+        return glm::mix(previous, position, blend);
+    }
+    glm::vec3 getDirection() const { return direction; }
 
-    using altitude_func = std::function<float(float, float)>;
-    void move(Direction d, float dt, altitude_func altitude);
+    // Move by `steer' (forwards, rightwards) times the speed over `dt', then
+    // stand on the ground given by `altitude(x, z)'. Any callable works, and
+    // is called exactly once.
+    template <typename Altitude>
+    void move(glm::vec2 steer, float dt, Altitude&& altitude);
     void tilt(float dx, float dy);
 
+    // Face the same way as `other'
+    void turnTo(const Camera& other);
+
+    // Start a new step of movement: where the camera is now becomes where
+    // getView() blends from
+    void settle() { previous = position; }
+
 private:
     glm::vec2 clamps;
 
     glm::vec3 position;
+    glm::vec3 previous;
 
     glm::vec3 direction;
     glm::vec3 right;
@@ -40,11 +51,22 @@ private:
     float pitch;
 
     static constexpr float move_speed = 1;
+    static constexpr float eye_height = 0.5;
     static constexpr float turn_speed = 0.1;
 
     void updateVectors();
 };
 
+template <typename Altitude>
+void Camera::move(glm::vec2 steer, float dt, Altitude&& altitude) {
+    position += (direction * steer.x + right * steer.y) * (move_speed * dt);
+
+    position.x = glm::clamp(position.x, 0.f, clamps[0]);
+    position.z = glm::clamp(position.z, 0.f, clamps[1]);
+
+    position.y = altitude(position.x, position.z) + eye_height;
+}
+
 }
 
 #endif
@@ -0,0 +1,64 @@
+#include "file_watcher.h"
+
+#include <iostream>
+#include <algorithm>
+
+#include <unistd.h>
+#include <sys/inotify.h>
+
+namespace world {
+
+FileWatcher::FileWatcher()
+    : m_fd { inotify_init1(IN_NONBLOCK | IN_CLOEXEC) }
+{
+    if (m_fd < 0)
+        std::cerr << "Warning: can't watch for file changes" << std::endl;
+}
+
+FileWatcher::~FileWatcher() {
+    if (m_fd >= 0)
+        close(m_fd);
+}
+
+void FileWatcher::watch(const std::string& directory) {
+    if (m_fd < 0)
+        return;
+
+    int wd = inotify_add_watch(m_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (wd < 0) {
+        std::cerr << "Warning: can't watch " << directory << " for changes" << std::endl;
+        return;
+    }
+    m_dirs.emplace_back(wd, directory);
+}
+
+std::vector<std::string> FileWatcher::poll() {
+    std::vector<std::string> changed;
+    if (m_fd < 0)
+        return changed;
+
+    alignas(inotify_event) char buffer[4096];
+    for (;;) {
+        ssize_t length = read(m_fd, buffer, sizeof(buffer));
+        if (length <= 0)
+            break;
+
+        for (char* p = buffer; p < buffer + length; ) {
+            auto event = reinterpret_cast<const inotify_event*>(p);
+            p += sizeof(inotify_event) + event->len;
+
+            auto dir = std::find_if(m_dirs.begin(), m_dirs.end(),
+                [&](const auto& d) { return d.first == event->wd; });
+            if (dir == m_dirs.end() || event->len == 0)
+                continue;
+
+            std::string path = dir->second + "/" + event->name;
+            if (std::find(changed.begin(), changed.end(), path) == changed.end())
+                changed.push_back(std::move(path));
+        }
+    }
+
+    return changed;
+}
+
+}
@@ -0,0 +1,35 @@
+#ifndef FILE_WATCHER_H_INCLUDED
+#define FILE_WATCHER_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <utility>
+
+namespace world {
+
+// Reports files written in a set of watched directories (via inotify).
+// Directories are watched rather than files so that editors which save by
+// replacing the file are still noticed.
+class FileWatcher {
+public:
+    FileWatcher();
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher& other) = delete;
+    FileWatcher& operator=(const FileWatcher& other) = delete;
+
+    // Start watching `directory' (not recursively)
+    void watch(const std::string& directory);
+
+    // Get the paths ("directory/name") of files changed since the last call.
+    // Never blocks.
+    std::vector<std::string> poll();
+
+private:
+    int m_fd;
+    std::vector<std::pair<int, std::string>> m_dirs; // watch descriptor, path
+};
+
+}
+
+#endif
@@ -0,0 +1,67 @@
+#include "heightmap.h"
+
+#include <stb_image.h>
+
+#include <memory>
+#include <stdexcept>
+
+namespace world {
+
+std::vector<float> loadHeightmap(const std::string& file, float scale, float offset,
+        unsigned& width, unsigned& depth)
+{
+    // stbi_load_16 widens 8-bit images to the full 16-bit range for us, so
+    // both kinds of image end up normalised by the same factor below
+    int cols;
+    int rows;
+    int channels;
+    std::unique_ptr<stbi_us, decltype(&stbi_image_free)> data {
+        stbi_load_16(file.c_str(), &cols, &rows, &channels, 1),
+        stbi_image_free,
+    };
+    if (!data) {
+        throw std::runtime_error("Could not load heightmap from \"" + file + "\": "
+                + stbi_failure_reason());
+    }
+
+    width = rows;
+    depth = cols;
+
+    const float factor = scale / 65535.f;
+    const std::size_t count = static_cast<std::size_t>(rows) * cols;
+
+    std::vector<float> heightmap(count);
+    for (std::size_t i = 0; i < count; ++i)
+        heightmap[i] = data.get()[i] * factor + offset;
+
+    return heightmap;
+}
+
+std::vector<glm::vec4> loadSplatMap(const std::string& file, unsigned& width, unsigned& depth) {
+    int cols;
+    int rows;
+    int channels;
+    std::unique_ptr<stbi_uc, decltype(&stbi_image_free)> data {
+        stbi_load(file.c_str(), &cols, &rows, &channels, 4),
+        stbi_image_free,
+    };
+    if (!data) {
+        throw std::runtime_error("Could not load splat map from \"" + file + "\": "
+                + stbi_failure_reason());
+    }
+
+    width = rows;
+    depth = cols;
+
+    const std::size_t count = static_cast<std::size_t>(rows) * cols;
+
+    std::vector<glm::vec4> splat(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        const stbi_uc* px = data.get() + 4 * i;
+        splat[i] = glm::vec4 { px[0], px[1], px[2], px[3] } / 255.f;
+    }
+
+    return splat;
+}
+
+}
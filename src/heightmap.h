@@ -0,0 +1,27 @@
+#ifndef HEIGHTMAP_H_INCLUDED
+#define HEIGHTMAP_H_INCLUDED
+
+#include <string>
+#include <vector>
+
+#include <glm/vec4.hpp>
+
+namespace world {
+
+// Decode a grayscale image (8 or 16 bits per channel; PNG, PGM, etc.) into a
+// heightmap. Pixel values are normalised to [0, 1], then multiplied by
+// `scale' and added to `offset'.
+//
+// Image rows run along x and columns along z, matching the layout of the
+// JSON `altitude' array. The dimensions are written to `width' and `depth'.
+// Throws std::runtime_error if the image can't be loaded.
+std::vector<float> loadHeightmap(const std::string& file, float scale, float offset,
+        unsigned& width, unsigned& depth);
+
+// Decode an RGBA image into per-texel weights in [0, 1], laid out like
+// loadHeightmap. Throws std::runtime_error if the image can't be loaded.
+std::vector<glm::vec4> loadSplatMap(const std::string& file, unsigned& width, unsigned& depth);
+
+}
+
+#endif
@@ -0,0 +1,197 @@
+#include "json_stream.h"
+
+#include <chrono>
+#include <memory>
+#include <random>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+
+namespace world {
+
+namespace {
+
+    // Minimal pull tokenizer over a streambuf. Only understands enough JSON to
+    // find object members and to delimit values; everything that isn't the
+    // streamed array is handed to jsoncpp as raw text.
+    class Scanner {
+    public:
+        Scanner(std::istream& in) : m_buf { in.rdbuf() } {}
+
+        int peek() {
+            skipSpace();
+            return m_buf->sgetc();
+        }
+
+        void expect(char c) {
+            if (peek() != c)
+                fail(std::string("expected '") + c + "'");
+            m_buf->sbumpc();
+        }
+
+        bool accept(char c) {
+            if (peek() != c)
+                return false;
+            m_buf->sbumpc();
+            return true;
+        }
+
+        std::string string() {
+            std::string s;
+            expect('"');
+            for (int c = m_buf->sbumpc(); c != '"'; c = m_buf->sbumpc()) {
+                if (c == EOF)
+                    fail("unterminated string");
+                if (c == '\\') {
+                    s.push_back(static_cast<char>(c));
+                    c = m_buf->sbumpc();
+                }
+                s.push_back(static_cast<char>(c));
+            }
+            return s;
+        }
+
+        float number() {
+            char text[64];
+            std::size_t len = 0;
+
+            skipSpace();
+            for (int c = m_buf->sgetc(); isNumberChar(c); c = m_buf->snextc()) {
+                if (len + 1 == sizeof(text))
+                    fail("number too long");
+                text[len++] = static_cast<char>(c);
+            }
+            text[len] = '\0';
+
+            char* end;
+            float value = std::strtof(text, &end);
+            if (len == 0 || end != text + len)
+                fail("expected a number");
+            return value;
+        }
+
+        // Copy the next value verbatim, without interpreting it
+        std::string raw() {
+            std::string s;
+            int depth = 0;
+            bool in_string = false;
+
+            skipSpace();
+            for (int c = m_buf->sgetc(); c != EOF; c = m_buf->snextc()) {
+                if (in_string) {
+                    if (c == '\\') {
+                        s.push_back(static_cast<char>(c));
+                        c = m_buf->snextc();
+                    } else if (c == '"') {
+                        in_string = false;
+                    }
+                } else if (c == '"') {
+                    in_string = true;
+                } else if (c == '[' || c == '{') {
+                    ++depth;
+                } else if (c == ']' || c == '}') {
+                    if (depth == 0)
+                        break;
+                    --depth;
+                } else if (c == ',' && depth == 0) {
+                    break;
+                }
+                s.push_back(static_cast<char>(c));
+            }
+            return s;
+        }
+
+        [[noreturn]] void fail(const std::string& what) {
+            throw std::runtime_error("JSON parse error: " + what);
+        }
+
+    private:
+        std::streambuf* m_buf;
+
+        void skipSpace() {
+            for (int c = m_buf->sgetc(); c != EOF && std::isspace(c); c = m_buf->snextc())
+                ;
+        }
+
+        static bool isNumberChar(int c) {
+            return std::isdigit(c) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+        }
+    };
+
+} // namespace
+
+Json::Value parseStreaming(std::istream& in, const std::string& key,
+        std::vector<float>& out,
+        const std::function<std::size_t(const Json::Value&)>& expected)
+{
+    Scanner scan { in };
+    Json::Value root { Json::objectValue };
+
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader { builder.newCharReader() };
+
+    scan.expect('{');
+    if (scan.accept('}'))
+        return root;
+
+    do {
+        std::string name = scan.string();
+        scan.expect(':');
+
+        if (name == key) {
+            out.clear();
+            out.reserve(expected(root));
+
+            scan.expect('[');
+            if (!scan.accept(']')) {
+                do {
+                    out.push_back(scan.number());
+                } while (scan.accept(','));
+                scan.expect(']');
+            }
+        } else {
+            std::string text = scan.raw();
+            std::string errors;
+            if (!reader->parse(text.data(), text.data() + text.size(), &root[name], &errors))
+                scan.fail("in \"" + name + "\": " + errors);
+        }
+    } while (scan.accept(','));
+
+    scan.expect('}');
+    return root;
+}
+
+void benchmarkParsing(std::ostream& out) {
+    using namespace std::chrono;
+    constexpr std::size_t count = 10000000;
+
+    // laid out like a level, with heights written the way exporters do
+    std::mt19937 random { 1 };
+    std::uniform_real_distribution<float> height { -20, 80 };
+    std::string text = "{\"width\": 2500, \"depth\": 4000, \"altitude\": [";
+    text.reserve(text.size() + count * 12);
+    char number[32];
+    for (std::size_t i = 0; i < count; ++i) {
+        int len = std::snprintf(number, sizeof(number), i ? ", %.4f" : "%.4f", height(random));
+        text.append(number, len);
+    }
+    text += "], \"sunlight\": [0.3, 1, 0.2]}";
+
+    std::istringstream in { std::move(text) };
+    std::vector<float> values;
+
+    auto start = high_resolution_clock::now();
+    parseStreaming(in, "altitude", values,
+        [](const Json::Value& head) -> std::size_t {
+            return head.get("width", 0).asUInt() * head.get("depth", 0).asUInt();
+        });
+    auto end = high_resolution_clock::now();
+
+    float seconds = duration<float>(end - start).count();
+    out << "Parsed " << values.size() << " values in " << seconds << "s ("
+        << values.size() / seconds / 1e6f << " M/s)\n";
+}
+
+}
@@ -0,0 +1,33 @@
+#ifndef JSON_STREAM_H_INCLUDED
+#define JSON_STREAM_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <istream>
+#include <ostream>
+#include <functional>
+
+#include <json/json.h>
+
+namespace world {
+
+// Parses the top-level JSON object read from `in', except for the member
+// named `key': that must be an array of numbers, which are streamed directly
+// into `out' without ever building a `Json::Value' for them.
+//
+// Just before the array is read, `expected' is called with the members seen
+// so far, and should return the number of values to reserve space for (or 0).
+//
+// Returns every other member of the object. Throws std::runtime_error if the
+// input is malformed.
+Json::Value parseStreaming(std::istream& in, const std::string& key,
+        std::vector<float>& out,
+        const std::function<std::size_t(const Json::Value&)>& expected);
+
+// Time parseStreaming() over a generated document of 10 million values, as
+// big as the largest levels, and print values per second to `out'
+void benchmarkParsing(std::ostream& out);
+
+}
+
+#endif
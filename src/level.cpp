@@ -1,4 +1,8 @@
 #include "level.h"
+#include "json_stream.h"
+#include "heightmap.h"
+#include "render/shapes.h"
+#include "render/parallel.h"
 #include <json/json.h>
 
 #include <glad/glad.h>
@@ -7,7 +11,7 @@
 
 #include <fstream>
 #include <algorithm>
-#include <iterator>
+#include <stdexcept>
 
 #include <iostream>
 #include <cstdlib>
@@ -15,70 +19,420 @@
 
 namespace world {
 
+namespace {
+
+    // The directory holding `path', or "." if it has none
+    std::string directoryOf(const std::string& path) {
+        auto slash = path.find_last_of('/');
+        return slash == path.npos ? "." : path.substr(0, slash);
+    }
+
+    std::string baseName(const std::string& path) {
+        auto slash = path.find_last_of('/');
+        return slash == path.npos ? path : path.substr(slash + 1);
+    }
+
+} // namespace
+
 Level::Level(std::string filename)
-    : m_camera { }
-    , m_shader { "shaders/main.vert", "shaders/main.frag" }
+    : m_filename { directoryOf(filename) + "/" + baseName(filename) }
+    , m_shaders { "shaders/main.vert", "shaders/main.frag", { "FOG" } }
+    , m_object_shaders { "shaders/object.vert", "shaders/object.frag", { "FOG" } }
+    , m_impostor_shaders { "shaders/impostor.vert", "shaders/impostor.frag", { "FOG" } }
+    , m_road_shaders { "shaders/road.vert", "shaders/road.frag", { "FOG" } }
+    , m_features { m_shaders.flag("FOG") }
+    , m_watcher { }
+    , m_frame { }
+    , m_sunlight { 0, 1, 0 }
+    , m_textures { }
     , m_terrain { std::nullopt }
+    , m_trees { }
+    , m_objects { }
+    , m_tree_mesh { render::treeMesh() }
+    , m_object_mesh { render::boxMesh() }
+    , m_impostor_distance { 6 }
+    , m_impostor_fade { 1.5f }
+    , m_tree_atlas { { render::tree_width, render::tree_height } }
+    , m_impostor_mesh { render::billboardMesh(render::tree_width, render::tree_height) }
+    , m_near_trees { }
+    , m_far_trees { }
+    , m_roads { }
+    , m_queue { }
 {
+    // let the driver compile every variant while we build the terrain
+    m_shaders.requestAll();
+    m_object_shaders.requestAll();
+    m_impostor_shaders.requestAll();
+    m_road_shaders.requestAll();
     load_from_file(filename);
+    m_shaders.finish();
+    m_object_shaders.finish();
+    m_impostor_shaders.finish();
+    m_road_shaders.finish();
+
+    setImpostorViews();
+    bakeImpostors();
+
+    m_watcher.watch("shaders");
+    m_watcher.watch(directoryOf(filename));
 }
 
 void Level::load_from_file(std::string filename) {
+    // the altitude array dwarfs everything else in the file, so stream it
+    // straight into the heightmap rather than building a Json::Value for it
+    std::vector<float> heightmap;
     Json::Value root;
-    (std::ifstream { filename }) >> root;
+
+    { using namespace std::chrono;
+        auto start = high_resolution_clock::now();
+        try {
+            std::ifstream file { filename };
+            root = parseStreaming(file, "altitude", heightmap,
+                [](const Json::Value& head) -> std::size_t {
+                    return head.get("width", 0).asUInt() * head.get("depth", 0).asUInt();
+                });
+        } catch (const std::runtime_error& e) {
+            std::cerr << "Could not read " << filename << ": " << e.what() << std::endl;
+            std::exit(1);
+        } catch (const Json::Exception& e) {
+            // a member of the wrong type
+            std::cerr << "Could not read " << filename << ": " << e.what() << std::endl;
+            std::exit(1);
+        }
+        auto end = high_resolution_clock::now();
+
+        float taken = duration<float>(end - start).count();
+        std::cout << "Parsed " << heightmap.size() << " heights in " << taken << "s ("
+                  << heightmap.size() / taken / 1e6f << " M/s)\n";
+    }
 
     // we handle in column-major order, but for readability we will
     // pretend we store in row-major order for the json files.
     unsigned width = root.get("depth", 0).asUInt();
     unsigned depth = root.get("width", 0).asUInt();
 
+    // alternatively, heights may come from a grayscale image
+    if (const Json::Value& image = root["heightmap"]; image.isObject()) {
+        try {
+            heightmap = loadHeightmap(image["file"].asString(),
+                    image.get("scale", 1).asFloat(), image.get("offset", 0).asFloat(),
+                    width, depth);
+        } catch (const std::runtime_error& e) {
+            std::cerr << e.what() << std::endl;
+            std::exit(1);
+        }
+    }
+
     if (width < 5 || depth < 5) {
         std::cerr << "Invalid size for " << filename << ": "
                   << width << ", " << depth << std::endl;
         std::exit(1);
     }
 
-    Json::Value alts = root["altitude"];
-
-    std::vector<float> heightmap;
-    heightmap.clear();
-    heightmap.reserve(width * depth);
-    std::transform(std::begin(alts), std::end(alts), std::back_inserter(heightmap),
-        [](auto node) { return node.asFloat(); });
-
     if (heightmap.size() != width * depth) {
         std::cerr << "Invalid altitude data given for " << filename << std::endl;
         std::exit(1);
     }
 
+    render::TerrainMaterials materials = loadMaterials(root);
+
     { using namespace std::chrono;
         auto start = high_resolution_clock::now();
-        m_terrain.emplace(width, depth, std::move(heightmap));
+        m_terrain.emplace(width, depth, std::move(heightmap), std::move(materials));
         auto end = high_resolution_clock::now();
         std::cout << "Time taken: " << duration<float>(end - start).count() << "\n";
     }
 
-    m_camera.setClamps({ width - 1, depth - 1 });
-    this->move(Direction::Forward, 0);
+    const Json::Value& sun = root["sunlight"];
+    if (sun.isArray() && sun.size() == 3) {
+        m_sunlight = glm::normalize(glm::vec3 {
+            sun[0].asFloat(), sun[1].asFloat(), sun[2].asFloat() });
+    }
+
+    m_trees = loadInstances(root["trees"]);
+    m_objects = loadInstances(root["other"]);
+
+    try {
+        placeRoads(root["roads"]);
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        std::exit(1);
+    }
+
+    m_impostor_distance = root.get("impostor_distance", m_impostor_distance).asFloat();
+    m_near_trees.reserve(m_trees.size());
+    m_far_trees.reserve(m_trees.size());
+
+}
+
+render::InstanceTable Level::loadInstances(const Json::Value& list) const {
+    render::InstanceTable table;
+    if (!list.isArray())
+        return table;
+
+    auto [width, depth] = m_terrain->size();
+    table.reserve(list.size());
+    for (const auto& entry : list) {
+        float x = entry.get("x", 0).asFloat();
+        float z = entry.get("z", 0).asFloat();
+        if (x < 0 || z < 0 || x > width - 1 || z > depth - 1) {
+            std::cerr << "Warning: ignoring object outside the level at "
+                      << x << ", " << z << std::endl;
+            continue;
+        }
+        table.push_back({ x, 0, z });
+    }
+
+    return table;
+}
+
+void Level::snapToGround(render::InstanceTable& table, const render::Terrain& terrain) {
+    render::parallelFor(table.size(), [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i)
+            table.y[i] = terrain.altitude(table.x[i], table.z[i]);
+    });
+}
+
+void Level::setImpostorViews() {
+    // constant, so set once per program rather than every frame
+    for (unsigned mask = 0; mask < m_impostor_shaders.count(); ++mask) {
+        const render::Shader& program = m_impostor_shaders.get(mask);
+        if (!program)
+            continue;
+        program.use();
+        program.setUniform(program.uniform("views"), render::ImpostorAtlas::views);
+    }
+}
+
+void Level::bakeImpostors() {
+    // a single tree, at the origin
+    render::InstancedMesh tree { render::treeMesh() };
+    render::InstanceTable origin;
+    origin.push_back({ 0, 0, 0 });
+    tree.setInstances(origin);
+
+    try {
+        m_tree_atlas.bake(tree, m_object_shaders.get(0), m_frame, m_sunlight);
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        std::exit(1);
+    }
+}
+
+std::vector<render::Road> Level::loadRoads(const Json::Value& list) const {
+    std::vector<render::Road> roads;
+    if (!list.isArray())
+        return roads;
+
+    for (const auto& entry : list) {
+        const Json::Value& spine = entry["spine"];
+        if (!spine.isArray() || spine.size() < 4 || spine.size() % 2) {
+            std::cerr << "Warning: ignoring road without a spine of (x, z) pairs" << std::endl;
+            continue;
+        }
+
+        render::Road road;
+        road.width = entry.get("width", 0.5).asFloat();
+        for (Json::ArrayIndex i = 0; i < spine.size(); i += 2)
+            road.spine.push_back({ spine[i].asFloat(), spine[i + 1].asFloat() });
+        roads.push_back(std::move(road));
+    }
+
+    return roads;
+}
+
+void Level::placeRoads(const Json::Value& list) {
+    placeGround(prepareGround(loadRoads(list)));
+}
+
+Level::Ground Level::prepareGround(const std::vector<render::Road>& roads) const {
+    // ours stays in use while this is built
+    Ground ground { *m_terrain, {}, m_trees, m_objects };
+
+    // flatten the ground first, so everything is built on the final surface
+    ground.terrain.carve(roads);
+    ground.terrain.bakeLighting(m_sunlight);
+    ground.terrain.bakeOcclusion();
+    ground.roads = render::buildRoads(roads, ground.terrain);
+
+    snapToGround(ground.trees, ground.terrain);
+    snapToGround(ground.objects, ground.terrain);
+    return ground;
+}
+
+void Level::placeGround(Ground ground) {
+    ground.terrain.upload();
+    std::vector<render::Mesh> roads;
+    roads.reserve(ground.roads.size());
+    for (render::MeshData& data : ground.roads)
+        roads.emplace_back(std::move(data.vertices), std::move(data.indices));
+
+    {
+        // the simulation walks on the terrain, but only waits for the swap
+        std::lock_guard<std::mutex> lock { m_ground_mutex };
+        *m_terrain = std::move(ground.terrain);
+    }
+    m_roads = std::move(roads);
+    m_trees = std::move(ground.trees);
+    m_objects = std::move(ground.objects);
+    m_object_mesh.setInstances(m_objects);
+}
+
+void Level::reloadRoads() {
+    // one at a time, going again after if need be
+    if (m_next_ground.valid()) {
+        m_reload_again = true;
+        return;
+    }
+
+    m_next_ground = std::async(std::launch::async, [this] {
+        // everything else in the level needs a restart to change
+        std::vector<float> ignored;
+        std::ifstream file { m_filename };
+        Json::Value root = parseStreaming(file, "altitude", ignored,
+            [](const Json::Value&) -> std::size_t { return 0; });
+        return prepareGround(loadRoads(root["roads"]));
+    });
+}
+
+void Level::finishReload() {
+    using namespace std::chrono_literals;
+    if (!m_next_ground.valid() || m_next_ground.wait_for(0s) != std::future_status::ready)
+        return;
+
+    try {
+        placeGround(m_next_ground.get());
+    } catch (const std::runtime_error& e) {
+        std::cerr << "Could not reload roads from " << m_filename << ": " << e.what() << std::endl;
+    } catch (const Json::Exception& e) {
+        std::cerr << "Could not reload roads from " << m_filename << ": " << e.what() << std::endl;
+    }
+
+    if (m_reload_again) {
+        m_reload_again = false;
+        reloadRoads();
+    }
 }
 
-void Level::render(const glm::mat4& projection) const {
-    glm::mat4 modelview = projection * m_camera.getView();
+render::TerrainMaterials Level::loadMaterials(const Json::Value& root) {
+    render::TerrainMaterials materials;
+    std::vector<std::string> layers;
+
+    // without any materials, cover everything with the default texture
+    const Json::Value& list = root["materials"];
+    if (!list.isArray() || list.empty()) {
+        layers.push_back("terrain.png");
+        materials.rules.emplace_back();
+    }
+
+    for (const auto& entry : list) {
+        if (layers.size() == render::Terrain::max_layers) {
+            std::cerr << "Warning: only " << render::Terrain::max_layers
+                      << " terrain materials are supported" << std::endl;
+            break;
+        }
+
+        render::MaterialRule rule;
+        rule.min_height = entry.get("min_height", rule.min_height).asFloat();
+        rule.max_height = entry.get("max_height", rule.max_height).asFloat();
+        rule.min_slope = entry.get("min_slope", rule.min_slope).asFloat();
+        rule.max_slope = entry.get("max_slope", rule.max_slope).asFloat();
+
+        layers.push_back(entry.get("texture", "terrain.png").asString());
+        materials.rules.push_back(rule);
+    }
+
+    try {
+        materials.layers = m_textures.acquireArray(layers);
+
+        if (const Json::Value& splat = root["splat"]; splat.isString()) {
+            materials.splat = loadSplatMap(splat.asString(),
+                    materials.splat_width, materials.splat_depth);
+        }
+    } catch (const std::runtime_error& e) {
+        std::cerr << e.what() << std::endl;
+        std::exit(1);
+    }
+
+    return materials;
+}
+
+void Level::update() {
+    finishReload();
+
+    const auto changed = m_watcher.poll();
+    if (std::find(changed.begin(), changed.end(), m_filename) != changed.end())
+        reloadRoads();
+
+    for (auto* shaders : { &m_shaders, &m_object_shaders, &m_impostor_shaders, &m_road_shaders }) {
+        bool uses_changed = false;
+        for (const auto& file : changed)
+            uses_changed |= shaders->uses(file);
+
+        if (uses_changed) {
+            if (shaders->reload()) {
+                std::cout << "Reloaded shaders\n";
+                if (shaders == &m_object_shaders)
+                    bakeImpostors();
+                if (shaders == &m_impostor_shaders)
+                    setImpostorViews();
+            } else
+                std::cerr << "Shader reload failed; keeping the previous version" << std::endl;
+        }
+    }
+}
+
+void Level::render(const glm::mat4& projection, const Camera& view, float blend) {
+    const glm::vec3 eye = view.getPosition(blend);
+
+    render::FrameData frame;
+    frame.view = view.getView(blend);
+    frame.projection = projection;
+    frame.viewProjection = projection * frame.view;
+    frame.cameraPosition = glm::vec4 { eye, 1 };
+    frame.sunDirection = glm::vec4 { m_sunlight, 0 };
+    m_frame.update(frame);
+
+    m_terrain->submit(m_queue, m_shaders.get(m_features));
+    for (const render::Mesh& roads : m_roads)
+        m_queue.submit(m_road_shaders.get(m_features), nullptr, roads);
+    // trees near the camera get the full mesh, the rest a billboard
+    render::selectImpostors(m_trees, eye, m_impostor_distance,
+            m_impostor_fade, m_near_trees, m_far_trees);
+    m_tree_mesh.streamInstances(m_near_trees);
+    m_impostor_mesh.streamInstances(m_far_trees);
+
+    m_tree_mesh.submit(m_queue, m_object_shaders.get(m_features));
+    m_impostor_mesh.submit(m_queue, m_impostor_shaders.get(m_features), &m_tree_atlas.texture());
+    m_object_mesh.submit(m_queue, m_object_shaders.get(m_features));
+    m_queue.flush();
+}
 
-    m_shader.use();
-    m_shader.setUniform("modelview", modelview);
+Camera Level::startingCamera() const {
+    std::unique_lock<std::mutex> lock { m_ground_mutex };
+    auto [width, depth] = m_terrain->size();
+    lock.unlock(); // walk() takes it again
 
-    m_terrain->render();
+    Camera camera;
+    camera.setClamps({ width - 1, depth - 1 });
+    walk(camera, { 0, 0 }, 0);
+    camera.settle();
+    return camera;
 }
 
-void Level::move(Direction dir, float dt) {
-    m_camera.move(dir, dt, [=](float x, float z) {
+void Level::walk(Camera& camera, glm::vec2 steer, float dt) const {
+    std::lock_guard<std::mutex> lock { m_ground_mutex };
+    camera.move(steer, dt, [this](float x, float z) {
         return m_terrain->altitude(x, z);
     });
 }
 
-void Level::tilt(float dx, float dy) {
-    m_camera.tilt(dx, dy);
+void Level::pick(const Camera& view) const {
+    auto hit = m_terrain->raycast(view.getPosition(), view.getDirection());
+    if (hit)
+        std::cout << "Picked ground at " << hit->x << ", " << hit->y << ", " << hit->z << '\n';
+    else
+        std::cout << "Nothing picked\n";
 }
 
 }
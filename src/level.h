@@ -5,14 +5,24 @@
 #include <vector>
 #include <utility>
 #include <optional>
+#include <mutex>
+#include <future>
 
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
 #include <glm/mat4x4.hpp>
+#include <json/json-forwards.h>
 
-#include "render/shader.h"
+#include "render/shader_variants.h"
+#include "render/frame.h"
 #include "render/terrain.h"
+#include "render/texture_registry.h"
+#include "render/render_queue.h"
+#include "render/instances.h"
+#include "render/impostors.h"
+#include "render/roads.h"
 #include "camera.h"
+#include "file_watcher.h"
 
 namespace world {
 
@@ -23,17 +33,91 @@ public:
     Level(std::string filename);
     void load_from_file(std::string filename);
 
-    void render(const glm::mat4& projection) const;
+    // Pick up any changes made to our files on disk. Roads are rebuilt in
+    // the background, and swapped in by a later call once ready.
+    void update();
 
-    using Direction = Camera::Direction;
-    void move(Direction dir, float dt);
-    void tilt(float dx, float dy);
+    // Draw the level as seen by `view', `blend' of the way (from 0 to 1)
+    // from its previous step to its latest
+    void render(const glm::mat4& projection, const Camera& view, float blend = 1);
+
+    // Draw counts since the last call, which should come once per frame
+    render::RenderQueue::Stats endFrame() { return m_queue.endFrame(); }
+
+    // A camera standing at the start of the level. Safe to call from another
+    // thread, like walk().
+    Camera startingCamera() const;
+
+    // Walk `camera' by `steer' (forwards, rightwards) over `dt', keeping to
+    // the ground. Safe to call from another thread while this one updates.
+    void walk(Camera& camera, glm::vec2 steer, float dt) const;
+
+    // Report the ground in the middle of `view', if any is in sight
+    void pick(const Camera& view) const;
 
 private:
-    Camera m_camera;
+    // The ground carved for a set of roads, and everything resting on it
+    struct Ground {
+        render::Terrain terrain;
+        std::vector<render::MeshData> roads;
+        render::InstanceTable trees;
+        render::InstanceTable objects;
+    };
+
+    render::TerrainMaterials loadMaterials(const Json::Value& root);
+    render::InstanceTable loadInstances(const Json::Value& list) const;
+    static void snapToGround(render::InstanceTable& table, const render::Terrain& terrain);
+    void bakeImpostors();
+    void setImpostorViews();
+    std::vector<render::Road> loadRoads(const Json::Value& list) const;
+    void placeRoads(const Json::Value& list);
+
+    // Build the ground for `roads' from a copy of ours, without GL, so that
+    // it can run on any thread while this one carries on drawing
+    Ground prepareGround(const std::vector<render::Road>& roads) const;
+
+    // Upload `ground' and swap it in for ours
+    void placeGround(Ground ground);
 
-    render::Shader m_shader;
+    // Start rebuilding the roads in the background, and swap them in once
+    // they're ready
+    void reloadRoads();
+    void finishReload();
+
+    std::string m_filename; // as reported by m_watcher
+    mutable std::mutex m_ground_mutex; // held while walking, or changing the ground
+
+    render::ShaderVariants m_shaders;
+    render::ShaderVariants m_object_shaders; // same features as m_shaders
+    render::ShaderVariants m_impostor_shaders; // likewise
+    render::ShaderVariants m_road_shaders;     // likewise
+    unsigned m_features; // which variant of m_shaders to draw with
+    FileWatcher m_watcher;
+    render::FrameUniforms m_frame;
+    glm::vec3 m_sunlight;
+    render::TextureRegistry m_textures;
     std::optional<render::Terrain> m_terrain; // delayed construction
+
+    render::InstanceTable m_trees;
+    render::InstanceTable m_objects;
+    render::InstancedMesh m_tree_mesh;
+    render::InstancedMesh m_object_mesh;
+
+    // distant trees are drawn as billboards, fading across a band
+    float m_impostor_distance;
+    float m_impostor_fade;
+    render::ImpostorAtlas m_tree_atlas;
+    render::InstancedMesh m_impostor_mesh;
+    render::InstanceTable m_near_trees; // rebuilt every frame
+    render::InstanceTable m_far_trees;
+
+    std::vector<render::Mesh> m_roads; // every road, split to fit 16-bit indices
+    render::RenderQueue m_queue;
+
+    // A reload of the roads under way, and whether the file changed again
+    // since it started. Last, so it finishes before anything it reads goes.
+    std::future<Ground> m_next_ground;
+    bool m_reload_again = false;
 };
 
 }
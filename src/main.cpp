@@ -8,8 +8,34 @@
 #include <iostream>
 #include <fstream>
 #include <functional>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cmath>
 
 #include "level.h"
+#include "simulation.h"
+#include "alloc_count.h"
+#include "json_stream.h"
+#include "render/extensions.h"
+#include "render/state.h"
+#include "render/line_of_sight.h"
+
+// Settings given on the command line after the level
+struct Options {
+    // wait until shortly before each vsync to read input, so that it's as
+    // fresh as possible when shown
+    bool pace = false;
+
+    // simulation steps per second, whatever the display rate
+    double step_rate = 120;
+
+    // instead of running, check that reading input and moving never allocate;
+    // needs a build with CHECK_ALLOC
+    bool check_alloc = false;
+};
 
 // Handles the overarching drawing and input
 // Needs OpenGL to be set up first
@@ -17,8 +43,11 @@ class Manager {
     GLFWwindow* window;
 
 public:
-    Manager(GLFWwindow* window, std::string level_filename)
-        : window { window }, level { level_filename }
+    Manager(GLFWwindow* window, std::string level_filename, Options options)
+        : window { window }
+        , level { level_filename }
+        , options { options }
+        , simulation { level, options.step_rate }
     {
         glfwSetWindowUserPointer(window, this);
         glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
@@ -26,28 +55,114 @@ public:
         glfwGetWindowSize(window, &screen_width, &screen_height);
         glfwGetCursorPos(window, &last_mouse_x, &last_mouse_y);
 
+        const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+        refresh_period = 1.0 / (mode && mode->refreshRate > 0 ? mode->refreshRate : 60);
+
         initOGL();
         setupCallbacks();
+        syncClocks();
+    }
+
+    ~Manager() {
+        for (auto& shown : in_flight)
+            spare_queries.push_back(shown.query);
+        glDeleteQueries(spare_queries.size(), spare_queries.data());
     }
 
     void mainLoop() {
-        float last = glfwGetTime();
+        double last_report = glfwGetTime();
+        double last_swap = last_report;
+        unsigned frames = 0;
+        render::state::BindStats binds;
+        render::RenderQueue::Stats draws;
+
         while (!glfwWindowShouldClose(window)) {
-            float now = glfwGetTime();
-            float dt = now - last;
-            last = now;
+            if (options.pace)
+                waitForLatch(last_swap);
+
+            // latch input right before building the view from it
+            glfwPollEvents();
+            double now = glfwGetTime();
+            simulation.control({ processInput(), look, now });
+
+            level.update();
+
+            // show the simulation part way between its last two steps,
+            // facing wherever the mouse says now
+            const world::Snapshot& latest = simulation.latest();
+            float blend = simulation.blend(latest, std::chrono::steady_clock::now());
+            view = latest.camera;
+            view.turnTo(look);
+            const double input_time = latest.input_time;
 
             glClearColor(0.f, 0.f, 0.f, 1.f);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-            level.render(projection);
-            processInput(dt);
+            level.render(projection, view, blend);
+
+            auto frame_binds = render::state::endFrame();
+            binds.issued += frame_binds.issued;
+            binds.avoided += frame_binds.avoided;
+            auto frame_draws = level.endFrame();
+            draws.submitted += frame_draws.submitted;
+            draws.state_changes += frame_draws.state_changes;
+            draws.draw_calls += frame_draws.draw_calls;
+            ++frames;
+            if (now - last_report >= 1) {
+                reportStats(binds, draws, frames);
+                syncClocks();
+                binds = {};
+                draws = {};
+                frames = 0;
+                last_report = now;
+            }
+
+            // how long building a frame takes, for pacing the next
+            double built = glfwGetTime();
+            build_time = build_time ? 0.9 * build_time + 0.1 * (built - now) : built - now;
 
             glfwSwapBuffers(window);
-            glfwPollEvents();
+            last_swap = glfwGetTime();
+
+            // the GPU records when it gets here, once the frame is done
+            GLuint query;
+            if (spare_queries.empty()) {
+                glGenQueries(1, &query);
+            } else {
+                query = spare_queries.back();
+                spare_queries.pop_back();
+            }
+            glQueryCounter(query, GL_TIMESTAMP);
+            in_flight.push_back({ query, input_time });
+            measureLatency(last_swap);
         }
     }
 
+    // Feed input to the running simulation for a while, as the main loop
+    // does, and report whether reading it, handing it over or stepping with
+    // it allocated anything
+    bool checkAllocations() {
+        constexpr int frames = 300;
+        constexpr std::chrono::milliseconds frame_time { 5 };
+
+        const unsigned first_step = simulation.steps();
+        const std::size_t step_allocations = simulation.stepAllocations();
+        std::size_t made = 0;
+        for (int i = 0; i < frames; ++i) {
+            std::size_t before = world::allocations();
+            // keep moving even with no keys held, so the ground is queried
+            glm::vec2 steer = processInput() + glm::vec2 { 1, 0.5f };
+            simulation.control({ steer, look, glfwGetTime() });
+            made += world::allocations() - before;
+            std::this_thread::sleep_for(frame_time);
+        }
+        const unsigned steps = simulation.steps() - first_step;
+        made += simulation.stepAllocations() - step_allocations;
+
+        std::cout << made << " allocations in " << frames << " frames of input and "
+                  << steps << " simulation steps" << std::endl;
+        return made == 0 && steps > 0;
+    }
+
 private:
     int screen_width;
     int screen_height;
@@ -58,24 +173,120 @@ private:
     world::Level level;
     glm::mat4 projection;
 
-    void processInput(float dt) {
+    Options options;
+    world::Simulation simulation; // after the level it walks on
+    world::Camera look; // turned by the mouse, here on the GL thread
+    world::Camera view; // as last drawn
+
+    double refresh_period; // seconds
+    double build_time = 0; // seconds, smoothed
+
+    // frames sent to the GPU but not yet finished, with when the input for
+    // the step they show was read
+    struct InFlight {
+        GLuint query; // for the GPU's time at the end of the frame
+        double input_time;
+    };
+    std::vector<InFlight> in_flight;
+    std::vector<GLuint> spare_queries;
+
+    // seconds to add to the GPU's clock for glfwGetTime()'s
+    double gpu_clock_offset = 0;
+
+    // input to the frame on screen, in refresh periods, since the last report
+    double latency_total = 0;
+    unsigned latency_count = 0;
+
+    // Sleep until there's just enough time left to build a frame before the
+    // vsync after `last_swap'
+    void waitForLatch(double last_swap) {
+        constexpr double margin = 0.002;
+        double latch = last_swap + refresh_period - build_time - margin;
+        double wait = latch - glfwGetTime();
+        if (wait > 0)
+            std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+    }
+
+    // Line the GPU's clock up with ours. Redone now and then, in case
+    // they drift apart.
+    void syncClocks() {
+        GLint64 gpu_time;
+        glGetInteger64v(GL_TIMESTAMP, &gpu_time);
+        gpu_clock_offset = glfwGetTime() - gpu_time * 1e-9;
+    }
+
+    // Count up the frames which have reached the screen. With vsync, a frame
+    // appears at the first refresh after the GPU finishes it; refreshes
+    // fall a whole number of periods from `last_swap', which returned on one.
+    void measureLatency(double last_swap) {
+        auto done = in_flight.begin();
+        for (; done != in_flight.end(); ++done) {
+            GLint available = GL_FALSE;
+            glGetQueryObjectiv(done->query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+
+            GLuint64 finished;
+            glGetQueryObjectui64v(done->query, GL_QUERY_RESULT, &finished);
+            spare_queries.push_back(done->query);
+
+            // nothing to measure until the first input reaches a step
+            if (!done->input_time)
+                continue;
+
+            double done_time = finished * 1e-9 + gpu_clock_offset;
+            double shown = last_swap
+                + std::ceil((done_time - last_swap) / refresh_period) * refresh_period;
+            latency_total += (shown - done->input_time) / refresh_period;
+            ++latency_count;
+        }
+        in_flight.erase(in_flight.begin(), done);
+    }
+
+    // Returns the movement asked for, as (forwards, rightwards)
+    glm::vec2 processInput() {
         if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
             glfwSetWindowShouldClose(window, true);
 
-        using Direction = world::Level::Direction;
+        // every key held adds to one move, with one ground query per step
+        glm::vec2 steer { 0, 0 };
         if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-            level.move(Direction::Forward, dt);
+            steer.x += 1;
         if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-            level.move(Direction::Back, dt);
+            steer.x -= 1;
         if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-            level.move(Direction::Left, dt);
+            steer.y -= 1;
         if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-            level.move(Direction::Right, dt);
+            steer.y += 1;
+        return steer;
+    }
+
+    // Show the average work done per frame in the title bar
+    void reportStats(const render::state::BindStats& binds,
+            const render::RenderQueue::Stats& draws, unsigned frames)
+    {
+        std::string title = "Graphics - per frame: "
+            + std::to_string(draws.submitted / frames) + " submitted, "
+            + std::to_string(draws.state_changes / frames) + " state changes, "
+            + std::to_string(draws.draw_calls / frames) + " draws; binds "
+            + std::to_string(binds.issued / frames) + " issued, "
+            + std::to_string(binds.avoided / frames) + " avoided";
+        if (latency_count) {
+            char latency[32];
+            std::snprintf(latency, sizeof(latency), "; latency %.1f frames",
+                    latency_total / latency_count);
+            title += latency;
+        }
+        glfwSetWindowTitle(window, title.c_str());
+
+        latency_total = 0;
+        latency_count = 0;
     }
 
     void setupCallbacks() {
         glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
         glfwSetCursorPosCallback(window, mouseMoveCallback);
+        glfwSetMouseButtonCallback(window, mouseButtonCallback);
     }
 
     void initOGL() {
@@ -106,17 +317,50 @@ private:
         self->last_mouse_x = xpos;
         self->last_mouse_y = ypos;
 
-        self->level.tilt(dx, dy);
+        self->look.tilt(dx, dy);
+    }
+
+    static void mouseButtonCallback(GLFWwindow* window, int button, int action, int) {
+        Manager* self = reinterpret_cast<Manager*>(glfwGetWindowUserPointer(window));
+
+        // the cursor is hidden, so pick whatever is straight ahead
+        if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS)
+            self->level.pick(self->view);
     }
 };
 
 // Provides GLFW initialization, and then hands everything over to the 'Manager' class.
 int main(int argc, char** argv) {
-    if (argc != 2) {
-        std::cout << "Usage: " << argv[0] << " <level>\n";
+    Options options;
+    bool usable = argc >= 2;
+    for (int i = 2; i < argc && usable; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--pace") {
+            options.pace = true;
+        } else if (arg == "--rate" && i + 1 < argc) {
+            options.step_rate = std::atof(argv[++i]);
+            usable = options.step_rate > 0;
+        } else if (arg == "--check-alloc" && world::counting_allocations) {
+            options.check_alloc = true;
+        } else {
+            usable = false;
+        }
+    }
+
+    if (!usable) {
+        std::cout << "Usage: " << argv[0] << " <level> [--pace] [--rate <steps per second>]"
+                  << " [--check-alloc]\n"
+                  << "       " << argv[0] << " --bench\n";
         std::exit(1);
     }
 
+    // no window needed
+    if (std::string { argv[1] } == "--bench") {
+        world::benchmarkParsing(std::cout);
+        render::benchmarkLineOfSight(std::cout);
+        return 0;
+    }
+
     glfwSetErrorCallback([](auto err, auto desc) {
         std::cerr << "Error " << err << ": " << desc << std::endl;
     });
@@ -140,15 +384,20 @@ int main(int argc, char** argv) {
         std::cerr << "Failed to initialize GLAD." << std::endl;
         std::exit(1);
     }
+    render::ext::load((GLADloadproc) glfwGetProcAddress);
     glfwSwapInterval(1);
 
+    bool passed = true;
     {
-        Manager m { window, argv[1] };
-        m.mainLoop();
+        Manager m { window, argv[1], options };
+        if (options.check_alloc)
+            passed = m.checkAllocations();
+        else
+            m.mainLoop();
     }
 
     glfwDestroyWindow(window);
     glfwTerminate();
 
-    return 0;
+    return passed ? 0 : 1;
 }
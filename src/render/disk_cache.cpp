@@ -0,0 +1,42 @@
+#include "disk_cache.h"
+
+#include <cerrno>
+#include <cstdio>
+
+#include <sys/stat.h>
+
+namespace render {
+
+namespace {
+
+    bool makeDirectories(const std::string& path) {
+        for (std::size_t i = path.find('/'); ; i = path.find('/', i + 1)) {
+            std::string prefix = path.substr(0, i);
+            if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST)
+                return false;
+            if (i == std::string::npos)
+                return true;
+        }
+    }
+
+} // namespace
+
+std::uint64_t hashBytes(std::string_view data, std::uint64_t h) {
+    for (unsigned char c : data) {
+        h ^= c;
+        h *= 0x100000001b3;
+    }
+    return h;
+}
+
+std::string cacheFile(const std::string& dir, std::uint64_t key, const std::string& extension) {
+    std::string path = "cache/" + dir;
+    if (!makeDirectories(path))
+        return {};
+
+    char name[17];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+    return path + "/" + name + extension;
+}
+
+}
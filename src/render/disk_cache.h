@@ -0,0 +1,21 @@
+#ifndef RENDER_DISK_CACHE_H_INCLUDED
+#define RENDER_DISK_CACHE_H_INCLUDED
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+namespace render {
+
+// Helpers shared by the on-disk caches kept under `cache/'.
+
+// 64-bit FNV-1a; pass a previous result as `h' to hash several pieces.
+std::uint64_t hashBytes(std::string_view data, std::uint64_t h = 0xcbf29ce484222325);
+
+// Get the file for entry `key' in the cache subdirectory `dir', creating the
+// directory if needed. Returns an empty string if that isn't possible.
+std::string cacheFile(const std::string& dir, std::uint64_t key, const std::string& extension);
+
+}
+
+#endif
@@ -0,0 +1,51 @@
+#include "extensions.h"
+
+namespace render::ext {
+
+bool program_binary = false;
+PFNGETPROGRAMBINARYPROC getProgramBinary = nullptr;
+PFNPROGRAMBINARYPROC programBinary = nullptr;
+PFNPROGRAMPARAMETERIPROC programParameteri = nullptr;
+
+PFNMAXSHADERCOMPILERTHREADSPROC maxShaderCompilerThreads = nullptr;
+
+bool texture_s3tc = false;
+
+bool supported(std::string_view name) {
+    int count;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (int i = 0; i < count; ++i) {
+        auto ext = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        if (name == ext)
+            return true;
+    }
+    return false;
+}
+
+void load(GLADloadproc loader) {
+    bool gl41 = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 1);
+
+    if (gl41 || supported("GL_ARB_get_program_binary")) {
+        getProgramBinary  = (PFNGETPROGRAMBINARYPROC)  loader("glGetProgramBinary");
+        programBinary     = (PFNPROGRAMBINARYPROC)     loader("glProgramBinary");
+        programParameteri = (PFNPROGRAMPARAMETERIPROC) loader("glProgramParameteri");
+
+        int formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        program_binary = getProgramBinary && programBinary && programParameteri && formats > 0;
+    }
+
+    if (supported("GL_KHR_parallel_shader_compile"))
+        maxShaderCompilerThreads = (PFNMAXSHADERCOMPILERTHREADSPROC) loader("glMaxShaderCompilerThreadsKHR");
+    else if (supported("GL_ARB_parallel_shader_compile"))
+        maxShaderCompilerThreads = (PFNMAXSHADERCOMPILERTHREADSPROC) loader("glMaxShaderCompilerThreadsARB");
+
+    if (maxShaderCompilerThreads) {
+        // let the driver pick how many threads to use
+        maxShaderCompilerThreads(0xFFFFFFFF);
+    }
+
+    texture_s3tc = supported("GL_EXT_texture_compression_s3tc");
+}
+
+}
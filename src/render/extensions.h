@@ -0,0 +1,50 @@
+#ifndef RENDER_EXTENSIONS_H_INCLUDED
+#define RENDER_EXTENSIONS_H_INCLUDED
+
+#include <string_view>
+#include <glad/glad.h>
+
+// Optional functionality beyond the GL 3.3 core that our glad build covers.
+// Everything here must be checked for before use.
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+namespace render::ext {
+
+typedef void (APIENTRYP PFNGETPROGRAMBINARYPROC)(GLuint program, GLsizei bufSize,
+        GLsizei* length, GLenum* binaryFormat, void* binary);
+typedef void (APIENTRYP PFNPROGRAMBINARYPROC)(GLuint program, GLenum binaryFormat,
+        const void* binary, GLsizei length);
+typedef void (APIENTRYP PFNPROGRAMPARAMETERIPROC)(GLuint program, GLenum pname, GLint value);
+typedef void (APIENTRYP PFNMAXSHADERCOMPILERTHREADSPROC)(GLuint count);
+
+// GL 4.1 / ARB_get_program_binary
+extern bool program_binary;
+extern PFNGETPROGRAMBINARYPROC getProgramBinary;
+extern PFNPROGRAMBINARYPROC programBinary;
+extern PFNPROGRAMPARAMETERIPROC programParameteri;
+
+// KHR_parallel_shader_compile / ARB_parallel_shader_compile
+extern PFNMAXSHADERCOMPILERTHREADSPROC maxShaderCompilerThreads;
+
+// EXT_texture_compression_s3tc
+extern bool texture_s3tc;
+
+// Is the named extension supported by the current context?
+bool supported(std::string_view name);
+
+// Look up everything above. Call once, after gladLoadGLLoader.
+void load(GLADloadproc loader);
+
+}
+
+#endif
@@ -0,0 +1,25 @@
+#include "frame.h"
+#include "state.h"
+#include <glad/glad.h>
+
+namespace render {
+
+FrameUniforms::FrameUniforms() {
+    glGenBuffers(1, &m_ubo);
+    state::bindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), nullptr, GL_STREAM_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, m_ubo);
+}
+
+FrameUniforms::~FrameUniforms() {
+    state::deleteBuffer(m_ubo);
+}
+
+void FrameUniforms::update(const FrameData& data) const {
+    // orphan the old storage so we never wait on last frame's draws
+    state::bindBuffer(GL_UNIFORM_BUFFER, m_ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &data);
+}
+
+}
@@ -0,0 +1,53 @@
+#ifndef RENDER_FRAME_H_INCLUDED
+#define RENDER_FRAME_H_INCLUDED
+
+#include <utility>
+
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+namespace render {
+
+// Constants shared by every draw in a frame. Matches the std140 layout of
+// the `Frame' uniform block:
+//
+//     layout (std140) uniform Frame {
+//         mat4 view;
+//         mat4 projection;
+//         mat4 viewProjection;
+//         vec4 cameraPosition;
+//         vec4 sunDirection;
+//     };
+struct FrameData {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec4 cameraPosition; // w unused
+    glm::vec4 sunDirection;   // normalised, pointing towards the sun; w unused
+};
+
+// Owns the uniform buffer backing the `Frame' block. Every shader program
+// has that block bound to `binding' when linked, so writing the buffer once
+// per frame updates all of them.
+class FrameUniforms {
+public:
+    static constexpr unsigned binding = 0;
+    static constexpr const char* block_name = "Frame";
+
+    FrameUniforms();
+    ~FrameUniforms();
+
+    // only moving
+    FrameUniforms(FrameUniforms&& other) : m_ubo { std::exchange(other.m_ubo, 0) } {}
+    FrameUniforms& operator=(FrameUniforms&& other) { std::swap(m_ubo, other.m_ubo); return *this; }
+
+    // Upload this frame's data
+    void update(const FrameData& data) const;
+
+private:
+    unsigned m_ubo;
+};
+
+}
+
+#endif
@@ -0,0 +1,147 @@
+#include "height_pyramid.h"
+
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+#include <glm/glm.hpp>
+
+namespace render {
+
+HeightPyramid::HeightPyramid(std::vector<float> heights, unsigned width, unsigned depth,
+        float spacing)
+    : m_heights { std::move(heights) }
+    , m_width { width }
+    , m_depth { depth }
+    , m_spacing { spacing }
+{
+    if (m_width < 2 || m_depth < 2 || m_heights.size() != m_width * m_depth)
+        throw std::runtime_error("Bad height grid");
+
+    // bilinear filtering stays within the corners of each cell
+    Level base { m_width - 1, m_depth - 1, {}, {} };
+    base.low.resize(base.width * base.depth);
+    base.high.resize(base.width * base.depth);
+    for (unsigned i = 0; i < base.width; ++i) {
+        for (unsigned j = 0; j < base.depth; ++j) {
+            const float* a = &m_heights[i * m_depth + j];
+            const float* b = a + m_depth;
+            base.low[i * base.depth + j] = std::min({ a[0], a[1], b[0], b[1] });
+            base.high[i * base.depth + j] = std::max({ a[0], a[1], b[0], b[1] });
+        }
+    }
+    m_levels.push_back(std::move(base));
+    reduce();
+}
+
+HeightPyramid::HeightPyramid(unsigned width, unsigned depth, std::vector<float> low,
+        std::vector<float> high)
+    : m_width { width + 1 }
+    , m_depth { depth + 1 }
+    , m_spacing { 0 }
+{
+    if (width < 1 || depth < 1 || low.size() != width * depth || high.size() != low.size())
+        throw std::runtime_error("Bad height bounds");
+
+    m_levels.push_back({ width, depth, std::move(low), std::move(high) });
+    reduce();
+}
+
+void HeightPyramid::reduce() {
+    while (m_levels.back().width > 1 || m_levels.back().depth > 1) {
+        const Level& below = m_levels.back();
+        Level next { (below.width + 1) / 2, (below.depth + 1) / 2, {}, {} };
+        next.low.resize(next.width * next.depth);
+        next.high.resize(next.width * next.depth);
+
+        for (unsigned i = 0; i < next.width; ++i) {
+            for (unsigned j = 0; j < next.depth; ++j) {
+                float low = std::numeric_limits<float>::infinity();
+                float high = -low;
+                for (unsigned a = 2 * i; a < std::min(2 * i + 2, below.width); ++a) {
+                    for (unsigned b = 2 * j; b < std::min(2 * j + 2, below.depth); ++b) {
+                        low = std::min(low, below.low[a * below.depth + b]);
+                        high = std::max(high, below.high[a * below.depth + b]);
+                    }
+                }
+                next.low[i * next.depth + j] = low;
+                next.high[i * next.depth + j] = high;
+            }
+        }
+        m_levels.push_back(std::move(next));
+    }
+}
+
+float HeightPyramid::lowest(unsigned level, unsigned i, unsigned j) const {
+    const Level& l = m_levels[level];
+    return l.low[i * l.depth + j];
+}
+
+float HeightPyramid::highest(unsigned level, unsigned i, unsigned j) const {
+    const Level& l = m_levels[level];
+    return l.high[i * l.depth + j];
+}
+
+bool HeightPyramid::contains(glm::vec2 p) const {
+    glm::vec2 size = extent();
+    return p.x >= 0 && p.y >= 0 && p.x <= size.x && p.y <= size.y;
+}
+
+float HeightPyramid::horizon(glm::vec3 from, glm::vec2 dir, float reach, float enough) const {
+    const glm::vec2 start { from.x, from.z };
+    const Level& base = m_levels.front();
+
+    // distance along the ray to leave the axis-aligned box [lo, hi]
+    auto exit = [&](glm::vec2 lo, glm::vec2 hi) {
+        float tx = dir.x > 0 ? (hi.x - start.x) / dir.x
+                 : dir.x < 0 ? (lo.x - start.x) / dir.x
+                 : std::numeric_limits<float>::infinity();
+        float tz = dir.y > 0 ? (hi.y - start.y) / dir.y
+                 : dir.y < 0 ? (lo.y - start.y) / dir.y
+                 : std::numeric_limits<float>::infinity();
+        return std::min(tx, tz);
+    };
+
+    // samples stay on multiples of the spacing, wherever the skips land
+    float best = -std::numeric_limits<float>::infinity();
+    for (unsigned step = 1; step * m_spacing <= reach; ) {
+        const float d = step * m_spacing;
+        const glm::vec2 q = start + dir * d;
+        if (!contains(q))
+            break;
+
+        // nothing further on can rise more steeply than this (while the best
+        // is below level, it is the farthest point which rises most)
+        if (highest() - from.y <= best * (best >= 0 ? d : reach))
+            break;
+
+        unsigned ci = std::min(static_cast<unsigned>(q.x / m_spacing), base.width - 1);
+        unsigned cj = std::min(static_cast<unsigned>(q.y / m_spacing), base.depth - 1);
+
+        // skip the largest cell around q which is too low to matter
+        bool skipped = false;
+        for (unsigned level = levels() - 1; level-- > 0 && !skipped; ) {
+            unsigned li = ci >> level;
+            unsigned lj = cj >> level;
+            float size = m_spacing * (1u << level);
+            glm::vec2 lo { li * size, lj * size };
+            float out = exit(lo, lo + size);
+            if (highest(level, li, lj) - from.y > best * (best >= 0 ? d : out))
+                continue;
+
+            step = std::max(static_cast<unsigned>(std::ceil(out / m_spacing)), step + 1);
+            skipped = true;
+        }
+        if (skipped)
+            continue;
+
+        best = std::max(best, (sample(q) - from.y) / d);
+        if (best >= enough)
+            break;
+        ++step;
+    }
+
+    return best;
+}
+
+}
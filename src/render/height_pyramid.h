@@ -0,0 +1,88 @@
+#ifndef RENDER_HEIGHT_PYRAMID_H_INCLUDED
+#define RENDER_HEIGHT_PYRAMID_H_INCLUDED
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+namespace render {
+
+// A regular grid of heights, read with bilinear filtering, plus the lowest
+// and highest height over each cell at a series of coarser levels: level 0
+// cells lie between neighbouring samples, and each level's cells cover 2x2
+// of the level below. Rays can then skip whole regions which can't matter.
+class HeightPyramid {
+public:
+    // `heights' holds `width' x `depth' samples, indexed [i * depth + j],
+    // with sample (i, j) at (i * spacing, j * spacing) in world units.
+    HeightPyramid(std::vector<float> heights, unsigned width, unsigned depth, float spacing);
+
+    // Bounds alone, for cells laid out however suits the caller: level 0 is
+    // `width' x `depth' cells, with their bounds in `low' and `high' indexed
+    // [i * depth + j]. Having no heights, it can't be sampled, and has no
+    // extent or horizon.
+    HeightPyramid(unsigned width, unsigned depth, std::vector<float> low, std::vector<float> high);
+
+    unsigned levels() const { return m_levels.size(); }
+    unsigned width(unsigned level) const { return m_levels[level].width; } // in cells
+    unsigned depth(unsigned level) const { return m_levels[level].depth; }
+    float spacing() const { return m_spacing; }
+    glm::vec2 extent() const { return { (m_width - 1) * m_spacing, (m_depth - 1) * m_spacing }; }
+
+    // Bounds of cell (i, j) at `level'
+    float lowest(unsigned level, unsigned i, unsigned j) const;
+    float highest(unsigned level, unsigned i, unsigned j) const;
+
+    // Bounds over everything
+    float lowest() const { return m_levels.back().low.front(); }
+    float highest() const { return m_levels.back().high.front(); }
+
+    bool contains(glm::vec2 p) const;
+
+    // Height at (x, z), clamped to the grid. Inline, since batched queries
+    // call it in their innermost loops.
+    float sample(glm::vec2 p) const {
+        float gx = std::min(std::max(p.x / m_spacing, 0.f), float(m_width - 1));
+        float gz = std::min(std::max(p.y / m_spacing, 0.f), float(m_depth - 1));
+        unsigned i = std::min(static_cast<unsigned>(gx), m_width - 2);
+        unsigned j = std::min(static_cast<unsigned>(gz), m_depth - 2);
+        float fx = gx - i;
+        float fz = gz - j;
+
+        const float* a = &m_heights[i * m_depth + j];
+        const float* b = a + m_depth;
+        float near = a[0] + (a[1] - a[0]) * fz;
+        float far = b[0] + (b[1] - b[0]) * fz;
+        return near + (far - near) * fx;
+    }
+
+    // The steepest rise (height over distance) seen looking from `from' along
+    // the unit direction `dir', out to `reach'. Stops early once it reaches
+    // `enough'. Returns -infinity if nothing was in range.
+    float horizon(glm::vec3 from, glm::vec2 dir, float reach,
+            float enough = std::numeric_limits<float>::infinity()) const;
+
+private:
+    struct Level {
+        unsigned width; // in cells
+        unsigned depth;
+        std::vector<float> low;
+        std::vector<float> high;
+    };
+
+    // Build every coarser level from the one before, up to a single cell
+    void reduce();
+
+    std::vector<float> m_heights;
+    unsigned m_width;
+    unsigned m_depth;
+    float m_spacing;
+    std::vector<Level> m_levels;
+};
+
+}
+
+#endif
@@ -0,0 +1,133 @@
+#include "impostors.h"
+#include "frame.h"
+#include "render_queue.h"
+
+#include <cmath>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
+
+namespace render {
+
+ImpostorAtlas::ImpostorAtlas(glm::vec2 size)
+    : m_size { size }
+    , m_tile_width { static_cast<int>(std::ceil(tile_height * size.x / size.y)) }
+    , m_texture { }
+{
+    m_texture.create(m_tile_width * views, tile_height, { false, false });
+}
+
+void ImpostorAtlas::bake(const InstancedMesh& mesh, const Shader& program,
+        const FrameUniforms& frame, glm::vec3 sun)
+{
+    using namespace std::chrono;
+    auto start = high_resolution_clock::now();
+
+    const int width = m_tile_width * views;
+
+    unsigned fbo;
+    unsigned depth;
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+            m_texture.get(), 0);
+
+    glGenRenderbuffers(1, &depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, tile_height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+
+    auto cleanup = [&]() {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteRenderbuffers(1, &depth);
+        glDeleteFramebuffers(1, &fbo);
+    };
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        cleanup();
+        throw std::runtime_error("Could not render impostor atlas");
+    }
+
+    int viewport[4];
+    float clear[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clear);
+
+    // the caller may not have turned depth testing on yet
+    const bool depth_test = glIsEnabled(GL_DEPTH_TEST);
+    glEnable(GL_DEPTH_TEST);
+
+    // fully transparent around the object
+    glViewport(0, 0, width, tile_height);
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // orthographic, so the billboard covers the same area from any distance
+    const float reach = std::max(m_size.x, m_size.y);
+    const glm::vec3 centre { 0, m_size.y / 2, 0 };
+
+    RenderQueue queue;
+    for (int i = 0; i < views; ++i) {
+        float angle = glm::two_pi<float>() * i / views;
+        glm::vec3 eye = centre + 2 * reach * glm::vec3 { std::cos(angle), 0, std::sin(angle) };
+
+        FrameData data;
+        data.view = glm::lookAt(eye, centre, { 0, 1, 0 });
+        data.projection = glm::ortho(-m_size.x / 2, m_size.x / 2,
+                -m_size.y / 2, m_size.y / 2, 0.f, 4 * reach);
+        data.viewProjection = data.projection * data.view;
+        data.cameraPosition = glm::vec4 { eye, 1 };
+        data.sunDirection = glm::vec4 { sun, 0 };
+        frame.update(data);
+
+        glViewport(i * m_tile_width, 0, m_tile_width, tile_height);
+        mesh.submit(queue, program);
+        queue.flush();
+    }
+
+    cleanup();
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glClearColor(clear[0], clear[1], clear[2], clear[3]);
+    if (!depth_test)
+        glDisable(GL_DEPTH_TEST);
+
+    m_texture.generateMipmaps();
+
+    auto end = high_resolution_clock::now();
+    std::cout << "Baked " << views << " impostor views in "
+              << duration<float>(end - start).count() << "s\n";
+}
+
+void selectImpostors(const InstanceTable& table, glm::vec3 eye, float near, float fade,
+        InstanceTable& meshes, InstanceTable& impostors)
+{
+    meshes.clear();
+    impostors.clear();
+
+    const float near2 = near * near;
+    const float far2 = (near + fade) * (near + fade);
+
+    for (std::size_t i = 0; i < table.size(); ++i) {
+        float dx = table.x[i] - eye.x;
+        float dz = table.z[i] - eye.z;
+        float d2 = dx * dx + dz * dz;
+
+        if (d2 < near2) {
+            meshes.push_back(table.position(i));
+        } else if (d2 >= far2) {
+            impostors.push_back(table.position(i));
+        } else {
+            float t = (std::sqrt(d2) - near) / fade;
+            meshes.push_back(table.position(i), 1 - t);
+            impostors.push_back(table.position(i), t);
+        }
+    }
+}
+
+}
@@ -0,0 +1,53 @@
+#ifndef RENDER_IMPOSTORS_H_INCLUDED
+#define RENDER_IMPOSTORS_H_INCLUDED
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include "texture.h"
+#include "instances.h"
+
+namespace render {
+
+class Shader;
+class FrameUniforms;
+
+// Pictures of an object taken from evenly spaced directions around it, side
+// by side in one texture, for drawing it as a flat billboard when it is too
+// far away for the detail to show.
+//
+// View i looks at the object from the direction (cos a, 0, sin a), with
+// a = 2 pi i / views.
+class ImpostorAtlas {
+public:
+    static constexpr int views = 8;
+    static constexpr int tile_height = 192; // pixels; tiles are as wide as needed
+
+    // `size' is the billboard's width and height in world units, which must
+    // enclose the object from every side
+    ImpostorAtlas(glm::vec2 size);
+
+    // Render one instance of `mesh' at the origin into each view, with
+    // `program', lit by `sun'. Leaves `frame' holding the last view's data.
+    void bake(const InstancedMesh& mesh, const Shader& program,
+            const FrameUniforms& frame, glm::vec3 sun);
+
+    const Texture& texture() const { return m_texture; }
+    glm::vec2 size() const { return m_size; }
+
+private:
+    glm::vec2 m_size;
+    int m_tile_width;
+    Texture m_texture;
+};
+
+// Split `table' by distance from `eye' (ignoring height) for drawing: those
+// nearer than `near' go in `meshes', those beyond `near + fade' in
+// `impostors', and those in between in both, with fades which add up to 1.
+// Both outputs are overwritten.
+void selectImpostors(const InstanceTable& table, glm::vec3 eye, float near, float fade,
+        InstanceTable& meshes, InstanceTable& impostors);
+
+}
+
+#endif
@@ -0,0 +1,77 @@
+#include "instances.h"
+#include "render_queue.h"
+#include "state.h"
+
+#include <utility>
+#include <glad/glad.h>
+
+namespace render {
+
+InstancedMesh::InstancedMesh(Mesh mesh)
+    : m_mesh { std::move(mesh) }
+{
+    glGenBuffers(1, &m_buffer);
+}
+
+InstancedMesh::~InstancedMesh() {
+    state::deleteBuffer(m_buffer);
+}
+
+InstancedMesh::InstancedMesh(InstancedMesh&& other)
+    : m_mesh { std::move(other.m_mesh) }
+    , m_buffer { std::exchange(other.m_buffer, 0) }
+    , m_count { std::exchange(other.m_count, 0) }
+{
+}
+
+InstancedMesh& InstancedMesh::operator=(InstancedMesh&& other) {
+    m_mesh = std::move(other.m_mesh);
+    std::swap(m_buffer, other.m_buffer);
+    std::swap(m_count, other.m_count);
+    return *this;
+}
+
+void InstancedMesh::setInstances(const InstanceTable& table) {
+    upload(table, GL_STATIC_DRAW);
+}
+
+void InstancedMesh::streamInstances(const InstanceTable& table) {
+    upload(table, GL_STREAM_DRAW);
+}
+
+void InstancedMesh::upload(const InstanceTable& table, unsigned usage) {
+    std::size_t previous = m_count;
+    m_count = table.size();
+    std::size_t column = m_count * sizeof(float);
+
+    // always respecify, so the driver can hand us fresh storage rather than
+    // wait for draws still reading the old instances
+    state::bindBuffer(GL_ARRAY_BUFFER, m_buffer);
+    glBufferData(GL_ARRAY_BUFFER, 4 * column, nullptr, usage);
+    glBufferSubData(GL_ARRAY_BUFFER, 0 * column, column, table.x.data());
+    glBufferSubData(GL_ARRAY_BUFFER, 1 * column, column, table.y.data());
+    glBufferSubData(GL_ARRAY_BUFFER, 2 * column, column, table.z.data());
+    glBufferSubData(GL_ARRAY_BUFFER, 3 * column, column, table.fade.data());
+
+    // the column offsets move with the count, so point at them again
+    if (m_count == previous && previous != 0)
+        return;
+
+    m_mesh.bind();
+    for (unsigned i = 0; i < 4; ++i) {
+        unsigned attribute = first_attribute + i;
+        glVertexAttribPointer(attribute, 1, GL_FLOAT, GL_FALSE, sizeof(float),
+                (void*) (i * column));
+        glVertexAttribDivisor(attribute, 1);
+        glEnableVertexAttribArray(attribute);
+    }
+}
+
+void InstancedMesh::submit(RenderQueue& queue, const Shader& program,
+        const Texture* material /* = nullptr */) const
+{
+    if (m_count)
+        queue.submitInstanced(program, material, m_mesh, m_count);
+}
+
+}
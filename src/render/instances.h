@@ -0,0 +1,73 @@
+#ifndef RENDER_INSTANCES_H_INCLUDED
+#define RENDER_INSTANCES_H_INCLUDED
+
+#include <vector>
+#include <cstddef>
+
+#include <glm/vec3.hpp>
+
+#include "mesh.h"
+
+namespace render {
+
+class Shader;
+class Texture;
+class RenderQueue;
+
+// Placements of many copies of one object, stored as a structure of arrays
+// so that per-instance passes only touch the fields they need.
+struct InstanceTable {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<float> fade; // 1 is fully drawn, dissolving away towards 0
+
+    std::size_t size() const { return x.size(); }
+    void clear() { x.clear(); y.clear(); z.clear(); fade.clear(); }
+    void reserve(std::size_t n) { x.reserve(n); y.reserve(n); z.reserve(n); fade.reserve(n); }
+
+    void push_back(glm::vec3 pos, float f = 1) {
+        x.push_back(pos.x);
+        y.push_back(pos.y);
+        z.push_back(pos.z);
+        fade.push_back(f);
+    }
+
+    glm::vec3 position(std::size_t i) const { return { x[i], y[i], z[i] }; }
+};
+
+// A mesh drawn once per row of an instance table, in a single call. The
+// table is copied into a buffer of per-instance attributes: its x, y, z and
+// fade columns one after another, read at `first_attribute' onwards.
+class InstancedMesh {
+public:
+    static constexpr unsigned first_attribute = 8;
+
+    InstancedMesh(Mesh mesh);
+    ~InstancedMesh();
+
+    // only moving
+    InstancedMesh(InstancedMesh&& other);
+    InstancedMesh& operator=(InstancedMesh&& other);
+
+    // Replace the instances drawn. Use streamInstances() for tables that
+    // change every frame.
+    void setInstances(const InstanceTable& table);
+    void streamInstances(const InstanceTable& table);
+    std::size_t instances() const { return m_count; }
+
+    // Queue every instance for drawing, if there are any
+    void submit(RenderQueue& queue, const Shader& program,
+            const Texture* material = nullptr) const;
+
+private:
+    Mesh m_mesh;
+    unsigned m_buffer;
+    std::size_t m_count = 0;
+
+    void upload(const InstanceTable& table, unsigned usage);
+};
+
+}
+
+#endif
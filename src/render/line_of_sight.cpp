@@ -0,0 +1,183 @@
+#include "line_of_sight.h"
+#include "parallel.h"
+
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <ostream>
+#include <algorithm>
+
+#include <glm/vec2.hpp>
+
+namespace render {
+
+namespace {
+
+    // queries marched side by side, in lockstep
+    constexpr unsigned lanes = 8;
+
+    // Whether the lowest end of the line clears every height around it, as
+    // found from the few pyramid cells which cover it between them
+    bool clearsBounds(const HeightPyramid& field, const SightQueries& q, std::size_t n) {
+        const float inv = 1 / field.spacing();
+        const unsigned w = field.width(0);
+        const unsigned d = field.depth(0);
+
+        auto cell = [](float g, unsigned count) {
+            return static_cast<unsigned>(std::min(std::max(g, 0.f), float(count - 1)));
+        };
+        const unsigned i0 = cell(std::min(q.ax[n], q.bx[n]) * inv, w);
+        const unsigned i1 = cell(std::max(q.ax[n], q.bx[n]) * inv, w);
+        const unsigned j0 = cell(std::min(q.az[n], q.bz[n]) * inv, d);
+        const unsigned j1 = cell(std::max(q.az[n], q.bz[n]) * inv, d);
+
+        unsigned level = 0;
+        while ((i1 >> level) - (i0 >> level) > 1 || (j1 >> level) - (j0 >> level) > 1)
+            ++level;
+
+        float high = std::max({
+            field.highest(level, i0 >> level, j0 >> level),
+            field.highest(level, i0 >> level, j1 >> level),
+            field.highest(level, i1 >> level, j0 >> level),
+            field.highest(level, i1 >> level, j1 >> level),
+        });
+        return std::min(q.ay[n], q.by[n]) > high;
+    }
+
+    // Walk up to `lanes' queries at once, a grid spacing at a time, until
+    // each has either gone underground or arrived
+    void march(const HeightPyramid& field, const SightQueries& q,
+            const std::size_t* which, unsigned count, unsigned char* visible)
+    {
+        float x[lanes], y[lanes], z[lanes];
+        float dx[lanes], dy[lanes], dz[lanes];
+        unsigned steps[lanes];
+        bool blocked[lanes];
+
+        unsigned longest = 0;
+        for (unsigned l = 0; l < lanes; ++l) {
+            // spare lanes repeat the first, and are ignored
+            std::size_t n = which[l < count ? l : 0];
+            float run = std::hypot(q.bx[n] - q.ax[n], q.bz[n] - q.az[n]);
+            steps[l] = std::max(1u, static_cast<unsigned>(std::ceil(run / field.spacing())));
+            x[l] = q.ax[n];
+            y[l] = q.ay[n];
+            z[l] = q.az[n];
+            dx[l] = (q.bx[n] - q.ax[n]) / steps[l];
+            dy[l] = (q.by[n] - q.ay[n]) / steps[l];
+            dz[l] = (q.bz[n] - q.az[n]) / steps[l];
+            blocked[l] = false;
+            longest = std::max(longest, l < count ? steps[l] : 0);
+        }
+
+        // the ends themselves may touch the ground
+        for (unsigned k = 1; k < longest; ++k) {
+            bool any = false;
+            for (unsigned l = 0; l < lanes; ++l) {
+                float h = field.sample({ x[l] + dx[l] * k, z[l] + dz[l] * k });
+                blocked[l] |= k < steps[l] && h >= y[l] + dy[l] * k;
+                any |= !blocked[l] && k + 1 < steps[l];
+            }
+            if (!any)
+                break;
+        }
+
+        for (unsigned l = 0; l < count; ++l)
+            visible[which[l]] = !blocked[l];
+    }
+
+    void checkRange(const HeightPyramid& field, const SightQueries& q,
+            std::size_t begin, std::size_t end, unsigned char* visible)
+    {
+        std::size_t pending[lanes];
+        unsigned count = 0;
+        for (std::size_t n = begin; n < end; ++n) {
+            if (clearsBounds(field, q, n)) {
+                visible[n] = true;
+                continue;
+            }
+            pending[count++] = n;
+            if (count == lanes) {
+                march(field, q, pending, count, visible);
+                count = 0;
+            }
+        }
+        if (count)
+            march(field, q, pending, count, visible);
+    }
+
+} // namespace
+
+void lineOfSight(const HeightPyramid& field, const SightQueries& queries,
+        std::vector<unsigned char>& visible, bool threaded)
+{
+    visible.assign(queries.size(), false);
+    if (!threaded) {
+        checkRange(field, queries, 0, queries.size(), visible.data());
+        return;
+    }
+
+    // split into whole blocks of lanes, so threads never share one
+    const std::size_t blocks = (queries.size() + lanes - 1) / lanes;
+    parallelFor(blocks, [&](std::size_t begin, std::size_t end) {
+        checkRange(field, queries, begin * lanes, std::min(end * lanes, queries.size()),
+                visible.data());
+    });
+}
+
+void benchmarkLineOfSight(std::ostream& out) {
+    using namespace std::chrono;
+    constexpr std::size_t queries_per_run = 200000;
+    constexpr float spacing = 0.25f;
+
+    std::mt19937 random { 1 };
+    out << "samples  length  threads  visible  queries/s\n";
+
+    for (unsigned size : { 65u, 257u, 1025u }) {
+        // rolling hills with some noise
+        std::uniform_real_distribution<float> noise { 0, 0.2f };
+        std::vector<float> heights(size * size);
+        for (unsigned i = 0; i < size; ++i)
+            for (unsigned j = 0; j < size; ++j)
+                heights[i * size + j] = 2 * std::sin(i * 0.05f) * std::cos(j * 0.07f) + noise(random);
+        const HeightPyramid field { std::move(heights), size, size, spacing };
+        const glm::vec2 extent = field.extent();
+
+        for (float length : { 4.f, 16.f, 64.f }) {
+            if (length > std::min(extent.x, extent.y) / 2)
+                continue;
+
+            std::uniform_real_distribution<float> across { 0, 1 };
+            std::uniform_real_distribution<float> angle { 0, 6.2831853f };
+            std::uniform_real_distribution<float> above { 0.1f, 2.5f };
+
+            SightQueries queries;
+            queries.reserve(queries_per_run);
+            while (queries.size() < queries_per_run) {
+                glm::vec2 a { across(random) * extent.x, across(random) * extent.y };
+                float t = angle(random);
+                glm::vec2 b = a + length * glm::vec2 { std::cos(t), std::sin(t) };
+                if (!field.contains(b))
+                    continue;
+                queries.push_back({ a.x, field.sample(a) + above(random), a.y },
+                        { b.x, field.sample(b) + above(random), b.y });
+            }
+
+            for (bool threaded : { false, true }) {
+                std::vector<unsigned char> visible;
+                auto start = high_resolution_clock::now();
+                lineOfSight(field, queries, visible, threaded);
+                auto end = high_resolution_clock::now();
+
+                float seconds = duration<float>(end - start).count();
+                auto seen = std::count(visible.begin(), visible.end(), true);
+                out << size << "x" << size << "  " << length << "  "
+                    << (threaded ? "all" : "1") << "  "
+                    << 100 * seen / queries.size() << "%  "
+                    << static_cast<std::size_t>(queries.size() / seconds) << "\n";
+            }
+        }
+    }
+}
+
+}
@@ -0,0 +1,51 @@
+#ifndef RENDER_LINE_OF_SIGHT_H_INCLUDED
+#define RENDER_LINE_OF_SIGHT_H_INCLUDED
+
+#include <vector>
+#include <cstddef>
+#include <iosfwd>
+
+#include <glm/vec3.hpp>
+
+#include "height_pyramid.h"
+
+namespace render {
+
+// Pairs of points to check for a clear view between, stored as a structure
+// of arrays so that a batch can be worked through several at a time.
+struct SightQueries {
+    std::vector<float> ax, ay, az; // from
+    std::vector<float> bx, by, bz; // to
+
+    std::size_t size() const { return ax.size(); }
+
+    void clear() {
+        ax.clear(); ay.clear(); az.clear();
+        bx.clear(); by.clear(); bz.clear();
+    }
+
+    void reserve(std::size_t n) {
+        ax.reserve(n); ay.reserve(n); az.reserve(n);
+        bx.reserve(n); by.reserve(n); bz.reserve(n);
+    }
+
+    void push_back(glm::vec3 a, glm::vec3 b) {
+        ax.push_back(a.x); ay.push_back(a.y); az.push_back(a.z);
+        bx.push_back(b.x); by.push_back(b.y); bz.push_back(b.z);
+    }
+};
+
+// For each query, whether the straight line between its points stays above
+// the ground in `field' (which its ends may touch). `visible' is
+// overwritten with one entry per query. With `threaded', the batch is split
+// over every core.
+void lineOfSight(const HeightPyramid& field, const SightQueries& queries,
+        std::vector<unsigned char>& visible, bool threaded = true);
+
+// Time lineOfSight() over generated terrain of several sizes, with segments
+// of several lengths, and print queries per second to `out'
+void benchmarkLineOfSight(std::ostream& out);
+
+}
+
+#endif
@@ -1,6 +1,8 @@
 #include "mesh.h"
+#include "state.h"
 
 #include <utility> // move
+#include <algorithm> // copy
 #include <cstddef> // offsetof
 
 #include <glad/glad.h>
@@ -18,9 +20,9 @@ Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned short> indices)
     unsigned vsize = m_vertices.size() * sizeof(Vertex);
     unsigned isize = m_indices.size() * sizeof(unsigned short);
 
-    glBindVertexArray(m_vao);
+    state::bindVertexArray(m_vao);
 
-    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    state::bindBuffer(GL_ARRAY_BUFFER, m_vbo);
     glBufferData(GL_ARRAY_BUFFER, vsize, m_vertices.data(), GL_STATIC_DRAW);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, isize, m_indices.data(), GL_STATIC_DRAW);
@@ -31,18 +33,24 @@ Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned short> indices)
             (void*) offsetof(Vertex, normal));
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
             (void*) offsetof(Vertex, texcoord));
+    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+            (void*) offsetof(Vertex, weights));
+    glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+            (void*) offsetof(Vertex, light));
 
     glEnableVertexAttribArray(0);
     glEnableVertexAttribArray(1);
     glEnableVertexAttribArray(2);
+    glEnableVertexAttribArray(3);
+    glEnableVertexAttribArray(4);
 
-    glBindVertexArray(0);
+    state::bindVertexArray(0);
 }
 
 Mesh::~Mesh() {
-    glDeleteBuffers(1, &m_vbo);
-    glDeleteBuffers(1, &m_ebo);
-    glDeleteVertexArrays(1, &m_vao);
+    state::deleteBuffer(m_vbo);
+    state::deleteBuffer(m_ebo);
+    state::deleteVertexArray(m_vao);
 }
 
 Mesh::Mesh(Mesh&& other)
@@ -64,8 +72,19 @@ Mesh& Mesh::operator=(Mesh&& other) {
     return *this;
 }
 
+void Mesh::setVertices(std::size_t first, const Vertex* data, std::size_t count) {
+    std::copy(data, data + count, m_vertices.begin() + first);
+
+    state::bindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(Vertex), count * sizeof(Vertex), data);
+}
+
+void Mesh::bind() const {
+    state::bindVertexArray(m_vao);
+}
+
 void Mesh::render() const {
-    glBindVertexArray(m_vao);
+    bind();
     glDrawElements(GL_TRIANGLES, m_indices.size(), GL_UNSIGNED_SHORT, 0);
 }
 
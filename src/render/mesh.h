@@ -2,9 +2,11 @@
 #define GRAPHICS_MESH_H_INCLUDED
 
 #include <vector>
+#include <cstddef>
 
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
 
 namespace render {
 
@@ -12,6 +14,14 @@ struct Vertex {
     glm::vec3 position;
     glm::vec3 normal;
     glm::vec2 texcoord;
+    glm::vec4 weights; // blend of material layers
+    glm::vec2 light;   // baked sunlight (x) and ambient occlusion (y)
+};
+
+// What a mesh holds, built up away from the GL thread before becoming one
+struct MeshData {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned short> indices;
 };
 
 class Mesh {
@@ -24,7 +34,17 @@ public:
 
     void render() const;
 
+    // bind the vertex array, for drawing ranges of indices
+    void bind() const;
+
+    // Overwrite `count' vertices from index `first' onwards
+    void setVertices(std::size_t first, const Vertex* data, std::size_t count);
+
     const std::vector<Vertex>& getVertices() const { return m_vertices; }
+    unsigned indexCount() const { return m_indices.size(); }
+
+    // get the GL vertex array id
+    unsigned get() const { return m_vao; }
 
 private:
     std::vector<Vertex> m_vertices;
@@ -0,0 +1,345 @@
+#include "mipmaps.h"
+#include "disk_cache.h"
+#include "extensions.h"
+#include "parallel.h"
+
+#include <stb_image.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <chrono>
+
+#include <sys/stat.h>
+
+namespace render {
+
+namespace {
+
+    struct CacheHeader {
+        std::uint32_t magic;
+        std::uint32_t width;
+        std::uint32_t height;
+        std::uint32_t channels;
+        std::uint32_t format;
+        std::uint32_t levels;
+        std::uint64_t size;
+    };
+
+    constexpr std::uint32_t cache_magic = 0x3150494d; // "MIP1"
+
+    // Entries are keyed on the file's identity and modification time, so
+    // editing the image invalidates them
+    std::string cachePath(const std::string& file, const MipLayout& layout) {
+        struct stat info;
+        if (stat(file.c_str(), &info) != 0)
+            return {};
+
+        auto bytes = [](const auto& value) {
+            return std::string_view { reinterpret_cast<const char*>(&value), sizeof(value) };
+        };
+
+        std::uint64_t h = hashBytes(file);
+        h = hashBytes(bytes(info.st_size), h);
+        h = hashBytes(bytes(info.st_mtime), h);
+        h = hashBytes(bytes(layout.channels), h);
+        h = hashBytes(bytes(layout.format), h);
+        return cacheFile("textures", h, ".mips");
+    }
+
+    // Cache entries always hold a single layer
+    CacheHeader headerFor(const MipLayout& layout) {
+        return {
+            cache_magic,
+            static_cast<std::uint32_t>(layout.width),
+            static_cast<std::uint32_t>(layout.height),
+            static_cast<std::uint32_t>(layout.channels),
+            layout.format,
+            static_cast<std::uint32_t>(layout.levels()),
+            layout.size() / layout.layers,
+        };
+    }
+
+    bool readCache(const std::string& path, const MipLayout& layout, unsigned char* out, int layer) {
+        std::ifstream in { path, std::ios::binary };
+
+        CacheHeader header;
+        CacheHeader expected = headerFor(layout);
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))
+                || std::memcmp(&header, &expected, sizeof(header)) != 0)
+            return false;
+
+        for (int level = 0; level < layout.levels(); ++level) {
+            auto dst = reinterpret_cast<char*>(out + layout.layerOffset(level, layer));
+            if (!in.read(dst, layout.layerSize(level)))
+                return false;
+        }
+        return true;
+    }
+
+    void writeCache(const std::string& path, const MipLayout& layout, const unsigned char* chain) {
+        std::ofstream out { path, std::ios::binary };
+
+        CacheHeader header = headerFor(layout);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(chain), header.size);
+    }
+
+    // One output row of the 2x2 box filter, for even widths. Nothing is
+    // clamped and the channel count is fixed, so compilers vectorise the
+    // loop, working on many pixels' bytes at once; no intrinsics needed.
+    template <int channels>
+    void downsampleRow(const unsigned char* row0, const unsigned char* row1, int dw,
+            unsigned char* out)
+    {
+        for (int x = 0; x < dw; ++x) {
+            for (int c = 0; c < channels; ++c) {
+                const int a = 2 * x * channels + c;
+                const int b = a + channels;
+                out[x * channels + c] = static_cast<unsigned char>(
+                    (row0[a] + row0[b] + row1[a] + row1[b] + 2) >> 2);
+            }
+        }
+    }
+
+    // 2x2 box filter, clamping at odd edges
+    void downsample(const unsigned char* src, int w, int h, int channels, unsigned char* dst) {
+        const int dw = std::max(1, w / 2);
+        const int dh = std::max(1, h / 2);
+
+        parallelFor(dh, [=](std::size_t begin, std::size_t end) {
+            for (int y = begin; y < static_cast<int>(end); ++y) {
+                const unsigned char* row0 = src + std::min(2 * y + 0, h - 1) * w * channels;
+                const unsigned char* row1 = src + std::min(2 * y + 1, h - 1) * w * channels;
+                unsigned char* out = dst + y * dw * channels;
+
+                if (w % 2 == 0) {
+                    switch (channels) {
+                        case 1: downsampleRow<1>(row0, row1, dw, out); continue;
+                        case 2: downsampleRow<2>(row0, row1, dw, out); continue;
+                        case 3: downsampleRow<3>(row0, row1, dw, out); continue;
+                        case 4: downsampleRow<4>(row0, row1, dw, out); continue;
+                    }
+                }
+
+                for (int x = 0; x < dw; ++x) {
+                    const int x0 = std::min(2 * x + 0, w - 1) * channels;
+                    const int x1 = std::min(2 * x + 1, w - 1) * channels;
+                    for (int c = 0; c < channels; ++c) {
+                        out[x * channels + c] = static_cast<unsigned char>(
+                            (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+                    }
+                }
+            }
+        });
+    }
+
+    using Block = unsigned char[16][4];
+
+    std::uint16_t pack565(const unsigned char* c) {
+        return static_cast<std::uint16_t>(((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | (c[2] >> 3));
+    }
+
+    void unpack565(std::uint16_t v, int* c) {
+        int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+        c[0] = (r << 3) | (r >> 2);
+        c[1] = (g << 2) | (g >> 4);
+        c[2] = (b << 3) | (b >> 2);
+    }
+
+    // DXT1 colour block: bounding box endpoints, four-colour mode
+    void compressColour(const Block& block, unsigned char* out) {
+        unsigned char lo[3] = { 255, 255, 255 };
+        unsigned char hi[3] = { 0, 0, 0 };
+        for (const auto& px : block) {
+            for (int c = 0; c < 3; ++c) {
+                lo[c] = std::min(lo[c], px[c]);
+                hi[c] = std::max(hi[c], px[c]);
+            }
+        }
+
+        std::uint16_t c0 = pack565(hi);
+        std::uint16_t c1 = pack565(lo);
+        if (c0 < c1)
+            std::swap(c0, c1);
+
+        std::uint32_t indices = 0;
+        if (c0 != c1) {
+            int palette[4][3];
+            unpack565(c0, palette[0]);
+            unpack565(c1, palette[1]);
+            for (int c = 0; c < 3; ++c) {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+
+            for (int i = 0; i < 16; ++i) {
+                int best = 0;
+                int best_dist = 1 << 30;
+                for (int p = 0; p < 4; ++p) {
+                    int dist = 0;
+                    for (int c = 0; c < 3; ++c) {
+                        int d = block[i][c] - palette[p][c];
+                        dist += d * d;
+                    }
+                    if (dist < best_dist) {
+                        best = p;
+                        best_dist = dist;
+                    }
+                }
+                indices |= static_cast<std::uint32_t>(best) << (2 * i);
+            }
+        }
+
+        out[0] = c0 & 0xff;
+        out[1] = c0 >> 8;
+        out[2] = c1 & 0xff;
+        out[3] = c1 >> 8;
+        for (int i = 0; i < 4; ++i)
+            out[4 + i] = (indices >> (8 * i)) & 0xff;
+    }
+
+    // DXT5 alpha block: min/max endpoints, eight-value mode
+    void compressAlpha(const Block& block, unsigned char* out) {
+        int a0 = 0;
+        int a1 = 255;
+        for (const auto& px : block) {
+            a0 = std::max<int>(a0, px[3]);
+            a1 = std::min<int>(a1, px[3]);
+        }
+
+        std::uint64_t indices = 0;
+        if (a0 != a1) {
+            int palette[8] = { a0, a1 };
+            for (int p = 1; p < 7; ++p)
+                palette[p + 1] = ((7 - p) * a0 + p * a1) / 7;
+
+            for (int i = 0; i < 16; ++i) {
+                int best = 0;
+                for (int p = 1; p < 8; ++p)
+                    if (std::abs(block[i][3] - palette[p]) < std::abs(block[i][3] - palette[best]))
+                        best = p;
+                indices |= static_cast<std::uint64_t>(best) << (3 * i);
+            }
+        }
+
+        out[0] = static_cast<unsigned char>(a0);
+        out[1] = static_cast<unsigned char>(a1);
+        for (int i = 0; i < 6; ++i)
+            out[2 + i] = (indices >> (8 * i)) & 0xff;
+    }
+
+    void compress(const unsigned char* src, int w, int h, int channels, unsigned char* dst) {
+        const int blocks_wide = (w + 3) / 4;
+        const int blocks_high = (h + 3) / 4;
+        const int block_size = (channels == 4) ? 16 : 8;
+
+        parallelFor(blocks_high, [=](std::size_t begin, std::size_t end) {
+            for (int by = begin; by < static_cast<int>(end); ++by) {
+                for (int bx = 0; bx < blocks_wide; ++bx) {
+                    Block block;
+                    for (int i = 0; i < 16; ++i) {
+                        int x = std::min(bx * 4 + i % 4, w - 1);
+                        int y = std::min(by * 4 + i / 4, h - 1);
+                        const unsigned char* px = src + (y * w + x) * channels;
+                        for (int c = 0; c < 4; ++c)
+                            block[i][c] = (c < channels) ? px[c] : 255;
+                    }
+
+                    unsigned char* out = dst + (by * blocks_wide + bx) * block_size;
+                    if (channels == 4) {
+                        compressAlpha(block, out);
+                        out += 8;
+                    }
+                    compressColour(block, out);
+                }
+            }
+        });
+    }
+
+} // namespace
+
+MipLayout mipLayout(int width, int height, int channels, bool compress, int layers) {
+    MipLayout layout { width, height, channels, layers, 0, { 0 } };
+    if (compress) {
+        layout.format = (channels == 4) ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+                                        : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    }
+
+    for (int level = 0; ; ++level) {
+        std::size_t w = layout.levelWidth(level);
+        std::size_t h = layout.levelHeight(level);
+
+        std::size_t size = layout.format
+            ? ((w + 3) / 4) * ((h + 3) / 4) * ((channels == 4) ? 16 : 8)
+            : w * h * channels;
+        layout.offsets.push_back(layout.offsets.back() + size * layers);
+
+        if (w == 1 && h == 1)
+            break;
+    }
+
+    return layout;
+}
+
+bool loadMips(const std::string& file, const MipLayout& layout, unsigned char* out, int layer) {
+    std::string cache = cachePath(file, layout);
+    if (!cache.empty() && readCache(cache, layout, out, layer))
+        return true;
+
+    using namespace std::chrono;
+    auto start = high_resolution_clock::now();
+
+    int w, h, c;
+    std::unique_ptr<unsigned char, decltype(&stbi_image_free)> image {
+        stbi_load(file.c_str(), &w, &h, &c, layout.channels),
+        stbi_image_free,
+    };
+    if (!image || w != layout.width || h != layout.height)
+        return false;
+
+    // build the chain for this layer contiguously, as it is cached, in our
+    // own memory: `out' may be write-only
+    std::vector<std::size_t> offsets { 0 };
+    for (int level = 0; level < layout.levels(); ++level)
+        offsets.push_back(offsets.back() + layout.layerSize(level));
+
+    std::vector<unsigned char> chain(offsets.back());
+    std::vector<unsigned char> current(image.get(), image.get() + std::size_t(w) * h * layout.channels);
+    std::vector<unsigned char> next;
+
+    for (int level = 0; level < layout.levels(); ++level) {
+        int lw = layout.levelWidth(level);
+        int lh = layout.levelHeight(level);
+        unsigned char* dst = chain.data() + offsets[level];
+
+        if (layout.format)
+            compress(current.data(), lw, lh, layout.channels, dst);
+        else
+            std::memcpy(dst, current.data(), layout.layerSize(level));
+
+        if (level + 1 < layout.levels()) {
+            next.resize(std::size_t(layout.levelWidth(level + 1)) * layout.levelHeight(level + 1)
+                        * layout.channels);
+            downsample(current.data(), lw, lh, layout.channels, next.data());
+            current.swap(next);
+        }
+    }
+
+    for (int level = 0; level < layout.levels(); ++level) {
+        std::memcpy(out + layout.layerOffset(level, layer), chain.data() + offsets[level],
+                layout.layerSize(level));
+    }
+    if (!cache.empty())
+        writeCache(cache, layout, chain.data());
+
+    auto end = high_resolution_clock::now();
+    std::cout << "Baked " << layout.levels() << " mip levels for " << file << " in "
+              << duration<float>(end - start).count() << "s\n";
+    return true;
+}
+
+}
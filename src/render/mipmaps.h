@@ -0,0 +1,50 @@
+#ifndef RENDER_MIPMAPS_H_INCLUDED
+#define RENDER_MIPMAPS_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+
+namespace render {
+
+// Where each level of a full mip chain lives in one contiguous block, laid
+// out exactly as the levels are passed to GL. For array textures, each level
+// holds that level of every layer in turn.
+struct MipLayout {
+    int width;
+    int height;
+    int channels;                     // 3 or 4
+    int layers;
+    unsigned format;                  // compressed GL format, or 0 for raw bytes
+    std::vector<std::size_t> offsets; // start of each level, then the total size
+
+    int levels() const { return static_cast<int>(offsets.size()) - 1; }
+    std::size_t size() const { return offsets.back(); }
+    std::size_t levelSize(int level) const { return offsets[level + 1] - offsets[level]; }
+
+    // one layer of a level
+    std::size_t layerSize(int level) const { return levelSize(level) / layers; }
+    std::size_t layerOffset(int level, int layer) const {
+        return offsets[level] + layer * layerSize(level);
+    }
+
+    int levelWidth(int level) const { return std::max(1, width >> level); }
+    int levelHeight(int level) const { return std::max(1, height >> level); }
+};
+
+// Lay out the mip chain for an image (or `layers' same-sized images). If
+// `compress' is set, levels are stored S3TC-compressed: DXT1 for RGB, DXT5
+// for RGBA.
+MipLayout mipLayout(int width, int height, int channels, bool compress, int layers = 1);
+
+// Fill layer `layer' of `out' (of `layout.size()' bytes) with the mip chain
+// for `file'. Comes from the cache under `cache/textures' if possible;
+// otherwise the image is decoded, filtered and compressed across all cores,
+// and the result cached for next time. Safe to call from any thread.
+// Returns false if the image can't be loaded or doesn't match the layout.
+bool loadMips(const std::string& file, const MipLayout& layout, unsigned char* out, int layer = 0);
+
+}
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef RENDER_PARALLEL_H_INCLUDED
+#define RENDER_PARALLEL_H_INCLUDED
+
+#include <vector>
+#include <thread>
+#include <algorithm>
+#include <cstddef>
+
+namespace render {
+
+// Split [0, count) into one contiguous chunk per core, and call
+// `body(begin, end)' for each chunk concurrently. The calling thread runs
+// the first chunk itself; returns once all chunks are done.
+template <typename Body>
+void parallelFor(std::size_t count, Body&& body) {
+    std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min(threads, count);
+    if (threads <= 1) {
+        if (count)
+            body(std::size_t { 0 }, count);
+        return;
+    }
+
+    std::size_t chunk = (count + threads - 1) / threads;
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads - 1);
+    for (std::size_t begin = chunk; begin < count; begin += chunk)
+        workers.emplace_back([&body, begin, end = std::min(begin + chunk, count)]() {
+            body(begin, end);
+        });
+
+    body(std::size_t { 0 }, std::min(chunk, count));
+
+    for (auto& worker : workers)
+        worker.join();
+}
+
+}
+
+#endif
@@ -0,0 +1,80 @@
+#include "program_cache.h"
+#include "extensions.h"
+#include "disk_cache.h"
+
+#include <cstdint>
+#include <vector>
+#include <fstream>
+#include <iterator>
+
+namespace render {
+
+namespace {
+
+    constexpr std::uint32_t magic = 0x42505247; // "GRPB"
+
+    std::string_view glString(unsigned name) {
+        auto str = reinterpret_cast<const char*>(glGetString(name));
+        return str ? str : "";
+    }
+
+} // namespace
+
+std::string programCacheFile(std::initializer_list<std::string_view> sources) {
+    if (!ext::program_binary)
+        return {};
+
+    std::uint64_t h = hashBytes(glString(GL_VENDOR));
+    h = hashBytes(glString(GL_RENDERER), h);
+    h = hashBytes(glString(GL_VERSION), h);
+    for (auto source : sources) {
+        h = hashBytes(source, h);
+        h = hashBytes({ "", 1 }, h); // keep boundaries between sources distinct
+    }
+
+    return cacheFile("shaders", h, ".bin");
+}
+
+bool loadProgramBinary(unsigned program, const std::string& file) {
+    if (file.empty())
+        return false;
+
+    std::ifstream in { file, std::ios::binary };
+    std::uint32_t header[2];
+    if (!in.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != magic)
+        return false;
+
+    std::vector<char> binary { std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>() };
+    ext::programBinary(program, header[1], binary.data(), binary.size());
+
+    // the driver may reject binaries at will, e.g. after an update
+    int success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    return success;
+}
+
+void saveProgramBinary(unsigned program, const std::string& file) {
+    if (file.empty())
+        return;
+
+    int length;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+
+    std::vector<char> binary(length);
+    unsigned format;
+    ext::getProgramBinary(program, length, nullptr, &format, binary.data());
+
+    std::uint32_t header[2] = { magic, format };
+    std::ofstream out { file, std::ios::binary };
+    out.write(reinterpret_cast<const char*>(header), sizeof(header));
+    out.write(binary.data(), binary.size());
+}
+
+void markProgramRetrievable(unsigned program) {
+    if (ext::program_binary)
+        ext::programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+}
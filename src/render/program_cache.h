@@ -0,0 +1,30 @@
+#ifndef RENDER_PROGRAM_CACHE_H_INCLUDED
+#define RENDER_PROGRAM_CACHE_H_INCLUDED
+
+#include <string>
+#include <string_view>
+#include <initializer_list>
+
+namespace render {
+
+// On-disk cache of linked program binaries, under `cache/shaders'. Entries
+// are keyed by a hash of the shader sources together with the GL vendor,
+// renderer and version strings, so driver updates invalidate them.
+
+// Get the cache file for a program built from `sources', or an empty string
+// if the context can't retrieve program binaries.
+std::string programCacheFile(std::initializer_list<std::string_view> sources);
+
+// Try to load `program' from the cache. Returns false (leaving the program
+// unlinked) if there is no usable entry.
+bool loadProgramBinary(unsigned program, const std::string& file);
+
+// Save a freshly linked `program' to the cache. Failure is not an error.
+void saveProgramBinary(unsigned program, const std::string& file);
+
+// Call before linking a program that will be saved.
+void markProgramRetrievable(unsigned program);
+
+}
+
+#endif
@@ -0,0 +1,129 @@
+#include "render_queue.h"
+#include "shader.h"
+#include "texture.h"
+#include "mesh.h"
+
+#include <algorithm>
+#include <glad/glad.h>
+
+namespace render {
+
+namespace {
+
+    // Most significant first: program, material, mesh, then the start of the
+    // range. GL names are small, so masking them only risks a worse order.
+    std::uint64_t sortKey(unsigned program, unsigned material, unsigned mesh, unsigned first) {
+        return (std::uint64_t(program  & 0xFFF) << 52)
+             | (std::uint64_t(material & 0xFFF) << 40)
+             | (std::uint64_t(mesh     & 0xFFF) << 28)
+             | (std::uint64_t(first) & 0xFFFFFFF);
+    }
+
+} // namespace
+
+void RenderQueue::submit(const Shader& program, const Texture* material, const Mesh& mesh,
+        unsigned first, unsigned count)
+{
+    ++m_stats.submitted;
+    if (count == 0)
+        return;
+
+    std::uint64_t key = sortKey(program.get(), material ? material->get() : 0, mesh.get(), first);
+    m_draws.push_back({ key, &program, material, &mesh, first, count, 0 });
+}
+
+void RenderQueue::submit(const Shader& program, const Texture* material, const Mesh& mesh) {
+    submit(program, material, mesh, 0, mesh.indexCount());
+}
+
+void RenderQueue::submitInstanced(const Shader& program, const Texture* material,
+        const Mesh& mesh, unsigned instances)
+{
+    ++m_stats.submitted;
+    if (instances == 0 || mesh.indexCount() == 0)
+        return;
+
+    std::uint64_t key = sortKey(program.get(), material ? material->get() : 0, mesh.get(), 0);
+    m_draws.push_back({ key, &program, material, &mesh, 0, mesh.indexCount(), instances });
+}
+
+void RenderQueue::flush() {
+    std::sort(m_draws.begin(), m_draws.end(),
+        [](const Draw& a, const Draw& b) { return a.key < b.key; });
+
+    const Shader* program = nullptr;
+    const Texture* material = nullptr;
+    const Mesh* mesh = nullptr;
+
+    for (const Draw& draw : m_draws) {
+        // a different mesh (or state) ends the current batch
+        bool same_batch = draw.program == program && draw.material == material
+                       && draw.mesh == mesh;
+        if (!same_batch)
+            issue();
+
+        if (draw.program != program) {
+            draw.program->use();
+            program = draw.program;
+            ++m_stats.state_changes;
+        }
+        if (draw.material != material && draw.material) {
+            draw.material->use();
+            material = draw.material;
+            ++m_stats.state_changes;
+        }
+        if (draw.mesh != mesh) {
+            draw.mesh->bind();
+            mesh = draw.mesh;
+            ++m_stats.state_changes;
+        }
+
+        const void* offset = reinterpret_cast<const void*>(draw.first * sizeof(unsigned short));
+        if (draw.instances) {
+            issue();
+            glDrawElementsInstanced(GL_TRIANGLES, draw.count, GL_UNSIGNED_SHORT, offset,
+                    draw.instances);
+            ++m_stats.draw_calls;
+            continue;
+        }
+
+        // extend the last range if this one carries straight on from it
+        if (!m_counts.empty()) {
+            auto end = static_cast<const char*>(m_offsets.back())
+                     + m_counts.back() * sizeof(unsigned short);
+            if (end == offset) {
+                m_counts.back() += draw.count;
+                continue;
+            }
+        }
+        m_counts.push_back(draw.count);
+        m_offsets.push_back(offset);
+    }
+
+    issue();
+
+    m_draws.clear();
+}
+
+void RenderQueue::issue() {
+    if (m_counts.size() == 1) {
+        glDrawElements(GL_TRIANGLES, m_counts.front(), GL_UNSIGNED_SHORT, m_offsets.front());
+    } else if (!m_counts.empty()) {
+        glMultiDrawElements(GL_TRIANGLES, m_counts.data(), GL_UNSIGNED_SHORT,
+                m_offsets.data(), m_counts.size());
+    }
+
+    if (!m_counts.empty())
+        ++m_stats.draw_calls;
+
+    m_counts.clear();
+    m_offsets.clear();
+}
+
+RenderQueue::Stats RenderQueue::endFrame() {
+    Stats result = m_stats;
+    m_stats = {};
+    return result;
+}
+
+}
@@ -0,0 +1,70 @@
+#ifndef RENDER_RENDER_QUEUE_H_INCLUDED
+#define RENDER_RENDER_QUEUE_H_INCLUDED
+
+#include <vector>
+#include <cstdint>
+
+namespace render {
+
+class Shader;
+class Texture;
+class Mesh;
+
+// Collects the frame's draws, then issues them sorted so that draws sharing
+// a program, material and mesh run together. Consecutive draws of the same
+// mesh are merged into a single (multi-)draw call, and adjacent index ranges
+// into a single range. Instanced draws are always issued on their own.
+//
+// Draws without a material (nullptr) leave whatever texture was bound.
+//
+// Everything submitted must outlive the next flush().
+class RenderQueue {
+public:
+    struct Stats {
+        unsigned submitted = 0;     // calls to submit()
+        unsigned state_changes = 0; // program, material or mesh switches
+        unsigned draw_calls = 0;    // draws actually issued to GL
+    };
+
+    // Draw `count' indices of `mesh' starting from index `first'
+    void submit(const Shader& program, const Texture* material, const Mesh& mesh,
+            unsigned first, unsigned count);
+
+    // Draw the whole mesh
+    void submit(const Shader& program, const Texture* material, const Mesh& mesh);
+
+    // Draw the whole mesh `instances' times
+    void submitInstanced(const Shader& program, const Texture* material, const Mesh& mesh,
+            unsigned instances);
+
+    // Sort, issue and clear everything submitted so far
+    void flush();
+
+    // Counts since the last call, which should come once per frame
+    Stats endFrame();
+
+private:
+    struct Draw {
+        std::uint64_t key;
+        const Shader* program;
+        const Texture* material;
+        const Mesh* mesh;
+        unsigned first;
+        unsigned count;
+        unsigned instances; // 0 if not instanced
+    };
+
+    std::vector<Draw> m_draws;
+    Stats m_stats;
+
+    // scratch space for merged multi-draws
+    std::vector<int> m_counts;
+    std::vector<const void*> m_offsets;
+
+    // draw the ranges gathered so far, with the current mesh
+    void issue();
+};
+
+}
+
+#endif
@@ -0,0 +1,184 @@
+#include "roads.h"
+#include "terrain.h"
+#include "parallel.h"
+
+#include <cmath>
+#include <chrono>
+#include <limits>
+#include <iostream>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+namespace render {
+
+namespace {
+
+    constexpr float sample_spacing = 0.1f; // between rows, along the road
+    constexpr int across = 5;              // vertices per row, to follow the ground sideways
+
+    // most vertices one mesh can index
+    constexpr std::size_t max_vertices = std::numeric_limits<unsigned short>::max() + 1u;
+
+    // rows of `across' vertices, joined up into quads once packed into meshes
+    struct Ribbon {
+        std::vector<Vertex> vertices;
+    };
+
+    // Uniform Catmull-Rom, passing through p1 at t = 0 and p2 at t = 1
+    glm::vec2 catmullRom(glm::vec2 p0, glm::vec2 p1, glm::vec2 p2, glm::vec2 p3, float t) {
+        float t2 = t * t;
+        float t3 = t2 * t;
+        return 0.5f * ((2.f * p1)
+                     + (p2 - p0) * t
+                     + (2.f * p0 - 5.f * p1 + 4.f * p2 - p3) * t2
+                     + (3.f * p1 - p0 - 3.f * p2 + p3) * t3);
+    }
+
+    Ribbon buildRibbon(const Road& road, const Terrain& terrain) {
+        Ribbon ribbon;
+        if (road.spine.size() < 2)
+            return ribbon;
+
+        const std::vector<glm::vec2> centre = roadCentre(road);
+        const int rows = centre.size();
+
+        // lay out every vertex first, so the heights come from one query
+        std::vector<glm::vec2> points;
+        std::vector<float> along;
+        points.reserve(rows * across);
+        along.reserve(rows);
+
+        glm::vec2 tangent { 1, 0 };
+        for (int r = 0; r < rows; ++r) {
+            glm::vec2 diff = centre[std::min(r + 1, rows - 1)] - centre[std::max(r - 1, 0)];
+            if (glm::dot(diff, diff) > 1e-12f)
+                tangent = glm::normalize(diff);
+            glm::vec2 side { -tangent.y, tangent.x };
+
+            for (int c = 0; c < across; ++c) {
+                float u = static_cast<float>(c) / (across - 1);
+                points.push_back(centre[r] + side * (u - 0.5f) * road.width);
+            }
+            along.push_back(r ? along.back() + glm::distance(centre[r - 1], centre[r]) : 0);
+        }
+
+        const std::vector<float> heights = terrain.altitudes(points);
+
+        const glm::vec4 surface { 0.25f, 0.25f, 0.27f, 1 };
+        ribbon.vertices.reserve(points.size());
+        for (int r = 0; r < rows; ++r) {
+            for (int c = 0; c < across; ++c) {
+                int v = r * across + c;
+                glm::vec3 pos { points[v].x, heights[v], points[v].y };
+                float u = static_cast<float>(c) / (across - 1);
+                ribbon.vertices.push_back({ pos, { 0, 1, 0 }, { u, along[r] }, surface, { 1, 1 } });
+            }
+        }
+
+        // normals from the neighbouring vertices in each direction
+        auto at = [&](int r, int c) -> const glm::vec3& {
+            r = std::clamp(r, 0, rows - 1);
+            c = std::clamp(c, 0, across - 1);
+            return ribbon.vertices[r * across + c].position;
+        };
+        for (int r = 0; r < rows; ++r) {
+            for (int c = 0; c < across; ++c) {
+                glm::vec3 forward = at(r + 1, c) - at(r - 1, c);
+                glm::vec3 sideways = at(r, c + 1) - at(r, c - 1);
+                glm::vec3 normal = glm::cross(sideways, forward);
+                if (normal.y < 0)
+                    normal = -normal;
+                if (glm::dot(normal, normal) > 1e-12f)
+                    ribbon.vertices[r * across + c].normal = glm::normalize(normal);
+            }
+        }
+
+        return ribbon;
+    }
+
+} // namespace
+
+std::vector<glm::vec2> roadCentre(const Road& road) {
+    const auto& spine = road.spine;
+    std::vector<glm::vec2> centre;
+    if (spine.empty())
+        return centre;
+
+    const int n = spine.size();
+    for (int i = 0; i + 1 < n; ++i) {
+        glm::vec2 p0 = spine[std::max(i - 1, 0)];
+        glm::vec2 p1 = spine[i];
+        glm::vec2 p2 = spine[i + 1];
+        glm::vec2 p3 = spine[std::min(i + 2, n - 1)];
+
+        int steps = std::max(1, static_cast<int>(std::ceil(glm::distance(p1, p2) / sample_spacing)));
+        for (int k = 0; k < steps; ++k)
+            centre.push_back(catmullRom(p0, p1, p2, p3, static_cast<float>(k) / steps));
+    }
+    centre.push_back(spine.back());
+    return centre;
+}
+
+std::vector<MeshData> buildRoads(const std::vector<Road>& roads, const Terrain& terrain) {
+    using namespace std::chrono;
+    auto start = high_resolution_clock::now();
+
+    std::vector<Ribbon> ribbons(roads.size());
+    parallelFor(roads.size(), [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i)
+            ribbons[i] = buildRibbon(roads[i], terrain);
+    });
+
+    // Pack the ribbons into as few meshes as their 16-bit indices allow.
+    // A ribbon that doesn't fit is split between rows, repeating the row
+    // where it breaks so that no quad is lost.
+    std::vector<MeshData> meshes;
+    std::vector<Vertex> vertices;
+    std::vector<unsigned short> indices;
+    std::size_t vertex_count = 0;
+    auto flush = [&] {
+        vertex_count += vertices.size();
+        if (!vertices.empty())
+            meshes.push_back({ std::move(vertices), std::move(indices) });
+        vertices.clear();
+        indices.clear();
+    };
+
+    for (const auto& ribbon : ribbons) {
+        const std::size_t rows = ribbon.vertices.size() / across;
+        std::size_t row = 0;
+        while (row + 1 < rows) {
+            const std::size_t room = (max_vertices - vertices.size()) / across;
+            if (room < 2) {
+                flush();
+                continue;
+            }
+
+            const std::size_t take = std::min(rows - row, room);
+            const unsigned short base = vertices.size();
+            vertices.insert(vertices.end(), ribbon.vertices.begin() + row * across,
+                    ribbon.vertices.begin() + (row + take) * across);
+            for (std::size_t r = 0; r + 1 < take; ++r) {
+                for (int c = 0; c + 1 < across; ++c) {
+                    unsigned short a = base + r * across + c;
+                    unsigned short b = a + 1;
+                    unsigned short d = a + across;
+                    unsigned short e = d + 1;
+
+                    indices.insert(indices.end(), { a, d, b, b, d, e });
+                }
+            }
+            row += take - 1;
+        }
+    }
+    flush();
+
+    auto end = high_resolution_clock::now();
+    std::cout << "Built " << roads.size() << " roads (" << vertex_count << " vertices, "
+              << meshes.size() << " meshes) in " << duration<float>(end - start).count() << "s\n";
+
+    return meshes;
+}
+
+}
@@ -0,0 +1,31 @@
+#ifndef RENDER_ROADS_H_INCLUDED
+#define RENDER_ROADS_H_INCLUDED
+
+#include <vector>
+#include <glm/vec2.hpp>
+
+#include "mesh.h"
+
+namespace render {
+
+class Terrain;
+
+// A road following a smooth curve through the (x, z) points of its spine
+struct Road {
+    float width;
+    std::vector<glm::vec2> spine;
+};
+
+// Points along the curve through the road's spine, about 0.1 units apart
+std::vector<glm::vec2> roadCentre(const Road& road);
+
+// Build meshes covering every road, as ribbons draped over the terrain. Roads
+// are built in parallel, and packed into as few meshes as 16-bit indices
+// allow. Needs no GL, so may run on any thread. The meshes' vertex colour (in `weights') is the road surface; their
+// texture coordinates run across the road in s, and along it in world units
+// in t.
+std::vector<MeshData> buildRoads(const std::vector<Road>& roads, const Terrain& terrain);
+
+}
+
+#endif
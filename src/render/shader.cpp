@@ -1,64 +1,156 @@
 #include "shader.h"
+#include "frame.h"
+#include "program_cache.h"
+#include "state.h"
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
 #include <string>
+#include <algorithm>
 #include <sstream>
 #include <iostream>
 #include <fstream>
 #include <cstdlib>
 
-static unsigned compile(std::string_view shader, int type) {
-    // Create the shader
-    unsigned id = glCreateShader(type);
+namespace {
 
-    // Compile it
-    const char* data = shader.data();
-    glShaderSource(id, 1, &data, nullptr);
-    glCompileShader(id);
+    std::string readFile(const std::string& file) {
+        return static_cast<const std::stringstream&>(
+                std::stringstream() << (std::ifstream { file }).rdbuf()
+            ).str();
+    }
 
-    // Check we succeeded
-    int success;
-    glGetShaderiv(id, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        char log[512];
-        glGetShaderInfoLog(id, 512, nullptr, log);
-        std::cerr << "Error: failed to compile shader\n" << log << std::endl;
-        std::exit(1);
+    // Insert `defines' after the #version line, which must stay first
+    std::string preprocess(const std::string& source, const std::vector<std::string>& defines) {
+        if (defines.empty())
+            return source;
+
+        std::size_t body = 0;
+        int line = 1;
+        if (source.compare(0, 8, "#version") == 0) {
+            body = source.find('\n');
+            body = (body == std::string::npos) ? source.size() : body + 1;
+            line = 2;
+        }
+
+        std::string result = source.substr(0, body);
+        for (const auto& define : defines)
+            result += "#define " + define + "\n";
+        result += "#line " + std::to_string(line) + "\n";
+        result.append(source, body, std::string::npos);
+        return result;
     }
 
-    return id;
-}
+    // Start compiling a stage; errors are picked up by Shader::finish()
+    unsigned compile(std::string_view shader, int type) {
+        unsigned id = glCreateShader(type);
+
+        const char* data = shader.data();
+        glShaderSource(id, 1, &data, nullptr);
+        glCompileShader(id);
+
+        return id;
+    }
+
+} // namespace
 
 namespace render {
 
-Shader::Shader(std::string vert, std::string frag) {
-    std::string vert_str { static_cast<const std::stringstream&>(
-            std::stringstream() << (std::ifstream { vert }).rdbuf()
-        ).str() };
+ShaderSource::ShaderSource(std::string vert_file, std::string frag_file)
+    : vert_file { std::move(vert_file) }
+    , frag_file { std::move(frag_file) }
+{
+    reload();
+}
 
-    std::string frag_str { static_cast<const std::stringstream&>(
-            std::stringstream() << (std::ifstream { frag }).rdbuf()
-        ).str() };
+void ShaderSource::reload() {
+    vert = readFile(vert_file);
+    frag = readFile(frag_file);
+}
+
+Shader::Shader(std::string vert, std::string frag)
+    : Shader { ShaderSource { std::move(vert), std::move(frag) }, {} }
+{
+    if (!finish())
+        std::exit(1);
+}
+
+Shader::Shader(const ShaderSource& source, const std::vector<std::string>& defines)
+    : m_id { glCreateProgram() }
+    , m_pending { true }
+{
+    std::string vert_str = preprocess(source.vert, defines);
+    std::string frag_str = preprocess(source.frag, defines);
+
+    // Reuse the program from a previous run if the driver will take it
+    m_cache = programCacheFile({ vert_str, frag_str });
+    if (loadProgramBinary(m_id, m_cache))
+        return;
 
     // Create the vertex and fragment shaders
-    unsigned vert_id = compile(vert_str, GL_VERTEX_SHADER);
-    unsigned frag_id = compile(frag_str, GL_FRAGMENT_SHADER);
+    m_stages.push_back(compile(vert_str, GL_VERTEX_SHADER));
+    m_stages.push_back(compile(frag_str, GL_FRAGMENT_SHADER));
 
-    // Link the program
-    m_id = glCreateProgram();
-    glAttachShader(m_id, vert_id);
-    glAttachShader(m_id, frag_id);
+    // Link the program; don't ask how it went until finish(), as querying
+    // the status forces the driver to wait for the compile
+    for (unsigned stage : m_stages)
+        glAttachShader(m_id, stage);
+    markProgramRetrievable(m_id);
     glLinkProgram(m_id);
+}
+
+Shader::Shader(Shader&& other)
+    : m_id { std::exchange(other.m_id, 0) }
+    , m_uniforms { std::move(other.m_uniforms) }
+    , m_pending { std::exchange(other.m_pending, false) }
+    , m_stages { std::move(other.m_stages) }
+    , m_cache { std::move(other.m_cache) }
+{
+}
+
+Shader& Shader::operator=(Shader&& other) {
+    std::swap(m_id, other.m_id);
+    m_uniforms.swap(other.m_uniforms);
+    std::swap(m_pending, other.m_pending);
+    m_stages.swap(other.m_stages);
+    m_cache.swap(other.m_cache);
+    return *this;
+}
+
+bool Shader::finish() {
+    if (!m_pending)
+        return true;
+    m_pending = false;
 
     // Check we succeeded
     int success;
     glGetProgramiv(m_id, GL_LINK_STATUS, &success);
     if (!success) {
         char log[512];
+
+        for (unsigned stage : m_stages) {
+            glGetShaderiv(stage, GL_COMPILE_STATUS, &success);
+            if (!success) {
+                glGetShaderInfoLog(stage, 512, nullptr, log);
+                std::cerr << "Error: failed to compile shader\n" << log << std::endl;
+                return false;
+            }
+        }
+
         glGetProgramInfoLog(m_id, 512, nullptr, log);
         std::cerr << "Error: failed to link shader program\n" << log << std::endl;
-        std::exit(1);
+        return false;
+    }
+
+    // Clean up, and keep the result for next time if we had to compile
+    if (!m_stages.empty()) {
+        for (unsigned stage : m_stages) {
+            glDetachShader(m_id, stage);
+            glDeleteShader(stage);
+        }
+        m_stages.clear();
+
+        saveProgramBinary(m_id, m_cache);
     }
 
     // Validate program
@@ -66,60 +158,145 @@ Shader::Shader(std::string vert, std::string frag) {
     glGetProgramiv(m_id, GL_VALIDATE_STATUS, &success);
     if (!success) {
         std::cerr << "Error: failed to validate shader program\n";
-        std::exit(1);
+        return false;
     }
 
-    // Clean up
-    glDeleteShader(vert_id);
-    glDeleteShader(frag_id);
+    // Share the per-frame constants, if this program uses them
+    unsigned frame_block = glGetUniformBlockIndex(m_id, FrameUniforms::block_name);
+    if (frame_block != GL_INVALID_INDEX)
+        glUniformBlockBinding(m_id, frame_block, FrameUniforms::binding);
+
+    cacheUniforms();
+    return true;
 }
 
 void Shader::release() {
-    glDeleteProgram(m_id);
+    for (unsigned stage : m_stages)
+        glDeleteShader(stage);
+    m_stages.clear();
+
+    state::deleteProgram(m_id);
     m_id = 0;
 }
 
+void Shader::cacheUniforms() {
+    m_uniforms.clear();
+
+    int count;
+    int max_length;
+    glGetProgramiv(m_id, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(m_id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+
+    std::string name(max_length, '\0');
+    for (int i = 0; i < count; ++i) {
+        int length;
+        int size;
+        unsigned type;
+        glGetActiveUniform(m_id, i, max_length, &length, &size, &type, name.data());
+
+        // uniforms in blocks have no location
+        int location = glGetUniformLocation(m_id, name.c_str());
+        if (location < 0)
+            continue;
+
+        // arrays are reported as "name[0]"; index them by their plain name
+        std::string_view key { name.data(), static_cast<std::size_t>(length) };
+        if (auto bracket = key.find('['); bracket != key.npos)
+            key = key.substr(0, bracket);
+
+        m_uniforms.emplace_back(key, location);
+    }
+
+    std::sort(m_uniforms.begin(), m_uniforms.end());
+}
+
+Shader::Uniform Shader::uniform(std::string_view name) const {
+    auto it = std::lower_bound(m_uniforms.begin(), m_uniforms.end(), name,
+        [](const auto& entry, std::string_view n) { return entry.first < n; });
+
+    if (it != m_uniforms.end() && it->first == name)
+        return { it->second };
+
+    // only whole arrays are cached; let GL find elements like "a[2]"
+    if (name.find('[') != name.npos)
+        return { glGetUniformLocation(m_id, std::string { name }.c_str()) };
+    return {};
+}
+
 void Shader::use() const {
-    glUseProgram(m_id);
+    state::useProgram(m_id);
+}
+
+void Shader::setUniform(Uniform u, bool value) const {
+    setUniform(u, (int)value);
+}
+
+void Shader::setUniform(Uniform u, int value) const {
+    glUniform1i(u.location, value);
+}
+
+void Shader::setUniform(Uniform u, float value) const {
+    glUniform1f(u.location, value);
+}
+
+void Shader::setUniform(Uniform u, const glm::vec2& value) const {
+    glUniform2fv(u.location, 1, &value[0]);
+}
+
+void Shader::setUniform(Uniform u, const glm::vec3& value) const {
+    glUniform3fv(u.location, 1, &value[0]);
+}
+
+void Shader::setUniform(Uniform u, const glm::vec4& value) const {
+    glUniform4fv(u.location, 1, &value[0]);
+}
+
+void Shader::setUniform(Uniform u, const glm::mat2& value) const {
+    glUniformMatrix2fv(u.location, 1, GL_FALSE, &value[0][0]);
+}
+
+void Shader::setUniform(Uniform u, const glm::mat3& value) const {
+    glUniformMatrix3fv(u.location, 1, GL_FALSE, &value[0][0]);
+}
+
+void Shader::setUniform(Uniform u, const glm::mat4& value) const {
+    glUniformMatrix4fv(u.location, 1, GL_FALSE, &value[0][0]);
 }
 
 void Shader::setUniform(const std::string& name, bool value) const {
-    setUniform(name, (int)value);
+    setUniform(uniform(name), value);
 }
 
 void Shader::setUniform(const std::string& name, int value) const {
-    glUniform1i(glGetUniformLocation(m_id, name.c_str()), value);
+    setUniform(uniform(name), value);
 }
 
 void Shader::setUniform(const std::string& name, float value) const {
-    glUniform1f(glGetUniformLocation(m_id, name.c_str()), value);
+    setUniform(uniform(name), value);
 }
 
 void Shader::setUniform(const std::string& name, const glm::vec2& value) const {
-    glUniform2fv(glGetUniformLocation(m_id, name.c_str()), 1, &value[0]);
+    setUniform(uniform(name), value);
 }
 
 void Shader::setUniform(const std::string& name, const glm::vec3& value) const {
-    glUniform3fv(glGetUniformLocation(m_id, name.c_str()), 1, &value[0]);
+    setUniform(uniform(name), value);
 }
 
 void Shader::setUniform(const std::string& name, const glm::vec4& value) const {
-    glUniform4fv(glGetUniformLocation(m_id, name.c_str()), 1, &value[0]);
+    setUniform(uniform(name), value);
 }
 
 void Shader::setUniform(const std::string& name, const glm::mat2& value) const {
-    glUniformMatrix2fv(glGetUniformLocation(m_id, name.c_str()),
-            1, GL_FALSE, &value[0][0]);
+    setUniform(uniform(name), value);
 }
 
 void Shader::setUniform(const std::string& name, const glm::mat3& value) const {
-    glUniformMatrix3fv(glGetUniformLocation(m_id, name.c_str()),
-            1, GL_FALSE, &value[0][0]);
+    setUniform(uniform(name), value);
 }
 
 void Shader::setUniform(const std::string& name, const glm::mat4& value) const {
-    glUniformMatrix4fv(glGetUniformLocation(m_id, name.c_str()),
-            1, GL_FALSE, &value[0][0]);
+    setUniform(uniform(name), value);
 }
 
 }
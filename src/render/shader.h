@@ -2,11 +2,27 @@
 #define SHADER_H_INCLUDED
 
 #include <string>
+#include <string_view>
+#include <vector>
 #include <utility>
 #include <glm/fwd.hpp>
 
 namespace render {
 
+// The text of a vertex and fragment shader pair
+struct ShaderSource {
+    // Read the source from the given files
+    ShaderSource(std::string vert_file, std::string frag_file);
+
+    // Read the files again
+    void reload();
+
+    std::string vert_file;
+    std::string frag_file;
+    std::string vert;
+    std::string frag;
+};
+
 // Encapsulates a shader program
 class Shader {
 public:
@@ -14,6 +30,15 @@ public:
     Shader(std::string vert, std::string frag);
     Shader() : m_id{0} {}
 
+    // Start building a shader from `source', with each of `defines' set.
+    // The program can't be used until finish() has been called; until then,
+    // the driver is free to compile it in the background.
+    Shader(const ShaderSource& source, const std::vector<std::string>& defines);
+
+    // Wait for the program to link and check it worked. If it didn't,
+    // reports the error and returns false; the program is left unusable.
+    bool finish();
+
     // Deletion
     ~Shader() { release(); };
     void release();
@@ -23,15 +48,37 @@ public:
     Shader& operator=(const Shader& other) = delete;
 
     // Moving is fine
-    Shader(Shader&& other) : m_id(other.m_id) { other.m_id = 0; }
-    Shader& operator=(Shader&& other) { std::swap(m_id, other.m_id); return *this; }
+    Shader(Shader&& other);
+    Shader& operator=(Shader&& other);
 
     // Get the OpenGL ID of the shader.
     unsigned get() const { return m_id; }
     operator unsigned() const { return m_id; }
 
+    // A uniform location looked up ahead of time, so that setting it
+    // doesn't need to go through the name at all.
+    struct Uniform {
+        int location = -1;
+    };
+
+    // Find a uniform in the cache built at link time. Arrays are cached by
+    // their plain name; single elements ("a[2]") are asked of GL instead.
+    // Inactive or unknown names give a handle that GL silently ignores.
+    Uniform uniform(std::string_view name) const;
+
     // Perform shader operations
     void use() const;
+    void setUniform(Uniform u, bool value) const;
+    void setUniform(Uniform u, int value) const;
+    void setUniform(Uniform u, float value) const;
+    void setUniform(Uniform u, const glm::vec2& value) const;
+    void setUniform(Uniform u, const glm::vec3& value) const;
+    void setUniform(Uniform u, const glm::vec4& value) const;
+    void setUniform(Uniform u, const glm::mat2& value) const;
+    void setUniform(Uniform u, const glm::mat3& value) const;
+    void setUniform(Uniform u, const glm::mat4& value) const;
+
+    // Convenience overloads; these look the name up on every call
     void setUniform(const std::string& name, bool value) const;
     void setUniform(const std::string& name, int value) const;
     void setUniform(const std::string& name, float value) const;
@@ -44,6 +91,16 @@ public:
 
 private:
     unsigned m_id;
+
+    // active uniform locations, sorted by name
+    std::vector<std::pair<std::string, int>> m_uniforms;
+
+    // while building: the stages to check, and where to cache the result
+    bool m_pending = false;
+    std::vector<unsigned> m_stages;
+    std::string m_cache;
+
+    void cacheUniforms();
 };
 
 }
@@ -0,0 +1,84 @@
+#include "shader_variants.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <chrono>
+#include <cstdlib>
+
+namespace render {
+
+ShaderVariants::ShaderVariants(std::string vert, std::string frag, std::vector<std::string> keys)
+    : m_source { std::move(vert), std::move(frag) }
+    , m_keys { std::move(keys) }
+    , m_variants { }
+{
+    if (m_keys.size() > 16)
+        throw std::length_error("Too many shader variant keys");
+
+    m_variants.resize(count());
+}
+
+unsigned ShaderVariants::flag(std::string_view key) const {
+    for (unsigned i = 0; i < m_keys.size(); ++i)
+        if (m_keys[i] == key)
+            return 1u << i;
+    return 0;
+}
+
+std::vector<std::string> ShaderVariants::defines(unsigned mask) const {
+    std::vector<std::string> result;
+    for (unsigned i = 0; i < m_keys.size(); ++i)
+        if (mask & (1u << i))
+            result.push_back(m_keys[i]);
+    return result;
+}
+
+void ShaderVariants::request(unsigned mask) {
+    if (m_variants[mask])
+        return;
+
+    m_variants[mask] = Shader { m_source, defines(mask) };
+}
+
+void ShaderVariants::requestAll() {
+    for (unsigned mask = 0; mask < count(); ++mask)
+        request(mask);
+}
+
+void ShaderVariants::finish() {
+    using namespace std::chrono;
+    auto start = high_resolution_clock::now();
+
+    for (auto& variant : m_variants)
+        if (!variant.finish())
+            std::exit(1);
+
+    auto end = high_resolution_clock::now();
+    std::cout << "Shaders (" << m_source.vert_file << ", " << m_source.frag_file
+              << "): waited " << duration<float>(end - start).count() << "s\n";
+}
+
+bool ShaderVariants::reload() {
+    // only adopt the new source once it's known to build, so that later
+    // requests don't pick up a broken version
+    ShaderSource source { m_source.vert_file, m_source.frag_file };
+
+    // start everything compiling before waiting on any of it
+    std::vector<Shader> fresh(count());
+    for (unsigned mask = 0; mask < count(); ++mask) {
+        if (m_variants[mask])
+            fresh[mask] = Shader { source, defines(mask) };
+    }
+
+    bool success = true;
+    for (auto& variant : fresh)
+        success = variant.finish() && success;
+
+    if (success) {
+        m_source = std::move(source);
+        m_variants.swap(fresh);
+    }
+    return success;
+}
+
+}
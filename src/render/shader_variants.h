@@ -0,0 +1,60 @@
+#ifndef RENDER_SHADER_VARIANTS_H_INCLUDED
+#define RENDER_SHADER_VARIANTS_H_INCLUDED
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "shader.h"
+
+namespace render {
+
+// A family of programs built from the same source, differing only in which
+// of a fixed set of #define keys are enabled. A variant is identified by a
+// bitmask: bit i set means keys[i] is defined.
+//
+// Variants are requested up front and compiled together, so the driver can
+// work on them in parallel (or at least while we do other loading), then
+// finished in one go before drawing.
+class ShaderVariants {
+public:
+    ShaderVariants(std::string vert, std::string frag, std::vector<std::string> keys);
+
+    // Get the mask bit for a key, or 0 if it isn't one of ours
+    unsigned flag(std::string_view key) const;
+
+    // Number of possible variants
+    unsigned count() const { return 1u << m_keys.size(); }
+
+    // Start compiling the variant for `mask', if not done already
+    void request(unsigned mask);
+    void requestAll();
+
+    // Wait for all requested variants to be built. Exits on failure.
+    void finish();
+
+    // Rebuild every requested variant from the (re-read) source files.
+    // The new programs only replace the current ones if all of them built
+    // successfully; otherwise the errors are reported, false returned, and
+    // later requests keep building from the old source.
+    bool reload();
+
+    // Is `file' one of our source files?
+    bool uses(const std::string& file) const {
+        return file == m_source.vert_file || file == m_source.frag_file;
+    }
+
+    // Get a finished variant
+    const Shader& get(unsigned mask) const { return m_variants[mask]; }
+
+private:
+    ShaderSource m_source;
+    std::vector<std::string> m_keys;
+    std::vector<Shader> m_variants; // indexed by mask; id 0 if not requested
+
+    std::vector<std::string> defines(unsigned mask) const;
+};
+
+}
+
+#endif
@@ -0,0 +1,86 @@
+#include "shapes.h"
+
+#include <cmath>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+namespace render {
+
+namespace {
+
+    struct Builder {
+        std::vector<Vertex> vertices;
+        std::vector<unsigned short> indices;
+
+        // flat-shaded triangle, counter-clockwise from outside
+        void triangle(glm::vec3 a, glm::vec3 b, glm::vec3 c, glm::vec4 colour) {
+            glm::vec3 normal = glm::normalize(glm::cross(b - a, c - a));
+            for (glm::vec3 p : { a, b, c }) {
+                indices.push_back(vertices.size());
+                vertices.push_back({ p, normal, { p.x, p.z }, colour, { 1, 1 } });
+            }
+        }
+
+        void quad(glm::vec3 a, glm::vec3 b, glm::vec3 c, glm::vec3 d, glm::vec4 colour) {
+            triangle(a, b, c, colour);
+            triangle(a, c, d, colour);
+        }
+
+        // axis-aligned box, without a bottom face
+        void box(glm::vec3 lo, glm::vec3 hi, glm::vec4 colour) {
+            glm::vec3 p[8];
+            for (int i = 0; i < 8; ++i)
+                p[i] = { i & 1 ? hi.x : lo.x, i & 2 ? hi.y : lo.y, i & 4 ? hi.z : lo.z };
+
+            quad(p[0], p[2], p[3], p[1], colour); // -z
+            quad(p[4], p[5], p[7], p[6], colour); // +z
+            quad(p[0], p[4], p[6], p[2], colour); // -x
+            quad(p[1], p[3], p[7], p[5], colour); // +x
+            quad(p[2], p[6], p[7], p[3], colour); // +y
+        }
+
+        // cone around the y axis, with a closed base
+        void cone(float base, float top, float radius, int sides, glm::vec4 colour) {
+            glm::vec3 apex { 0, top, 0 };
+            glm::vec3 centre { 0, base, 0 };
+            for (int i = 0; i < sides; ++i) {
+                float a0 = glm::two_pi<float>() * i / sides;
+                float a1 = glm::two_pi<float>() * (i + 1) / sides;
+                glm::vec3 p0 { radius * std::cos(a0), base, radius * std::sin(a0) };
+                glm::vec3 p1 { radius * std::cos(a1), base, radius * std::sin(a1) };
+
+                triangle(p1, p0, apex, colour);
+                triangle(p0, p1, centre, colour);
+            }
+        }
+
+        Mesh build() { return { std::move(vertices), std::move(indices) }; }
+    };
+
+} // namespace
+
+Mesh treeMesh() {
+    Builder b;
+    b.box({ -0.05f, 0, -0.05f }, { 0.05f, 0.3f, 0.05f }, { 0.4f, 0.25f, 0.1f, 1 });
+    b.cone(0.2f, 1.0f, 0.3f, 8, { 0.1f, 0.45f, 0.15f, 1 });
+    return b.build();
+}
+
+Mesh boxMesh() {
+    Builder b;
+    b.box({ -0.15f, 0, -0.15f }, { 0.15f, 0.3f, 0.15f }, { 0.6f, 0.45f, 0.25f, 1 });
+    return b.build();
+}
+
+Mesh billboardMesh(float width, float height) {
+    float w = width / 2;
+    std::vector<Vertex> vertices {
+        { { -w, 0, 0 },      { 0, 0, 1 }, { 0, 0 }, { 1, 1, 1, 1 }, { 1, 1 } },
+        { {  w, 0, 0 },      { 0, 0, 1 }, { 1, 0 }, { 1, 1, 1, 1 }, { 1, 1 } },
+        { {  w, height, 0 }, { 0, 0, 1 }, { 1, 1 }, { 1, 1, 1, 1 }, { 1, 1 } },
+        { { -w, height, 0 }, { 0, 0, 1 }, { 0, 1 }, { 1, 1, 1, 1 }, { 1, 1 } },
+    };
+    return { std::move(vertices), { 0, 1, 2, 0, 2, 3 } };
+}
+
+}
@@ -0,0 +1,27 @@
+#ifndef RENDER_SHAPES_H_INCLUDED
+#define RENDER_SHAPES_H_INCLUDED
+
+#include "mesh.h"
+
+namespace render {
+
+// Simple procedural meshes for level objects, standing on the origin with
+// +y up. Their vertex colour is stored in the `weights' attribute.
+
+// A conical tree on a short trunk, about one unit tall
+Mesh treeMesh();
+
+// Width and height of a billboard enclosing treeMesh() from any side
+constexpr float tree_width = 0.7f;
+constexpr float tree_height = 1.05f;
+
+// A crate, 0.3 units on each side
+Mesh boxMesh();
+
+// An upright quad, `width' wide and `height' tall, centred on the y axis.
+// Texture coordinates span [0, 1] from the bottom left.
+Mesh billboardMesh(float width, float height);
+
+}
+
+#endif
@@ -0,0 +1,130 @@
+#include "state.h"
+
+#include <array>
+#include <glad/glad.h>
+
+namespace render::state {
+
+namespace {
+
+    // nothing is known until we have bound it ourselves
+    constexpr unsigned unknown = ~0u;
+
+    constexpr std::array<unsigned, 2> texture_targets { GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY };
+    constexpr std::array<unsigned, 4> buffer_targets {
+        GL_ARRAY_BUFFER, GL_UNIFORM_BUFFER, GL_PIXEL_UNPACK_BUFFER, GL_PIXEL_PACK_BUFFER,
+    };
+    constexpr int texture_units = 16;
+
+    struct Bindings {
+        unsigned program = unknown;
+        unsigned vao = unknown;
+        unsigned active_unit = 0; // as GL starts out
+        std::array<std::array<unsigned, texture_targets.size()>, texture_units> textures;
+        std::array<unsigned, buffer_targets.size()> buffers;
+
+        Bindings() {
+            for (auto& unit : textures)
+                unit.fill(unknown);
+            buffers.fill(unknown);
+        }
+    };
+
+    Bindings current;
+    BindStats stats;
+
+    template <std::size_t N>
+    int indexOf(const std::array<unsigned, N>& targets, unsigned target) {
+        for (std::size_t i = 0; i < N; ++i)
+            if (targets[i] == target)
+                return i;
+        return -1;
+    }
+
+    // Returns true if the call needs to be made, and records the new value
+    bool change(unsigned& slot, unsigned value) {
+        if (slot == value) {
+            ++stats.avoided;
+            return false;
+        }
+        slot = value;
+        ++stats.issued;
+        return true;
+    }
+
+    void activeTexture(unsigned unit) {
+        if (change(current.active_unit, unit))
+            glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+} // namespace
+
+void useProgram(unsigned program) {
+    if (change(current.program, program))
+        glUseProgram(program);
+}
+
+void bindVertexArray(unsigned vao) {
+    if (change(current.vao, vao))
+        glBindVertexArray(vao);
+}
+
+void bindBuffer(unsigned target, unsigned buffer) {
+    int i = indexOf(buffer_targets, target);
+    if (i < 0) {
+        ++stats.issued;
+        glBindBuffer(target, buffer);
+    } else if (change(current.buffers[i], buffer)) {
+        glBindBuffer(target, buffer);
+    }
+}
+
+void bindTexture(unsigned target, unsigned texture, int unit /* = -1 */) {
+    if (unit >= 0)
+        activeTexture(unit);
+
+    int t = indexOf(texture_targets, target);
+    unsigned active = current.active_unit;
+    if (t < 0 || active >= texture_units) {
+        ++stats.issued;
+        glBindTexture(target, texture);
+    } else if (change(current.textures[active][t], texture)) {
+        glBindTexture(target, texture);
+    }
+}
+
+void deleteProgram(unsigned program) {
+    // a program in use lingers until replaced, but don't rely on that
+    if (current.program == program)
+        current.program = unknown;
+    glDeleteProgram(program);
+}
+
+void deleteVertexArray(unsigned vao) {
+    if (current.vao == vao)
+        current.vao = 0;
+    glDeleteVertexArrays(1, &vao);
+}
+
+void deleteBuffer(unsigned buffer) {
+    for (auto& bound : current.buffers)
+        if (bound == buffer)
+            bound = 0;
+    glDeleteBuffers(1, &buffer);
+}
+
+void deleteTexture(unsigned texture) {
+    for (auto& unit : current.textures)
+        for (auto& bound : unit)
+            if (bound == texture)
+                bound = 0;
+    glDeleteTextures(1, &texture);
+}
+
+BindStats endFrame() {
+    BindStats result = stats;
+    stats = {};
+    return result;
+}
+
+}
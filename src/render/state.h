@@ -0,0 +1,37 @@
+#ifndef RENDER_STATE_H_INCLUDED
+#define RENDER_STATE_H_INCLUDED
+
+// Shadows the GL binding state, so that binding something that is already
+// bound never reaches the driver. Every bind and delete of programs, vertex
+// arrays, textures and (non-element) buffers must go through here, or the
+// shadow copy goes stale.
+//
+// Element array bindings belong to the bound vertex array, so they are not
+// tracked; bind those with glBindBuffer directly.
+
+namespace render::state {
+
+struct BindStats {
+    unsigned issued = 0;  // calls passed on to GL
+    unsigned avoided = 0; // calls skipped as redundant
+};
+
+void useProgram(unsigned program);
+void bindVertexArray(unsigned vao);
+void bindBuffer(unsigned target, unsigned buffer);
+
+// Binds to the given unit, or to the active unit if `unit' is negative
+void bindTexture(unsigned target, unsigned texture, int unit = -1);
+
+// Delete the object, and forget it if it is bound
+void deleteProgram(unsigned program);
+void deleteVertexArray(unsigned vao);
+void deleteBuffer(unsigned buffer);
+void deleteTexture(unsigned texture);
+
+// Counts since the last call, which should come once per frame
+BindStats endFrame();
+
+}
+
+#endif
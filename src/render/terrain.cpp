@@ -1,20 +1,33 @@
 #include "terrain.h"
+#include "parallel.h"
+#include "disk_cache.h"
 #include <cmath>
 #include <tuple>
+#include <algorithm>
 #include <glm/glm.hpp>
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include <cstdint>
+#include <glm/gtc/constants.hpp>
 
-#ifdef DEBUG
 #include <limits>
+
+#ifdef DEBUG
+#include <stdexcept>
 #endif
 
 namespace render {
 
-Terrain::Terrain(unsigned width, unsigned depth, std::vector<float> heightmap)
+Terrain::Terrain(unsigned width, unsigned depth, std::vector<float> heightmap,
+        TerrainMaterials materials)
     : m_width { width }
     , m_depth { depth }
     , m_heightmap { std::move(heightmap) }
-    , m_tex { "terrain.png" }
-    , m_mesh { std::nullopt }
+    , m_knotW { knots(m_width) }
+    , m_knotH { knots(m_depth) }
+    , m_materials { std::move(materials) }
+    , m_mesh { }
 {
 #ifdef DEBUG
     if (m_width * m_depth > std::numeric_limits<unsigned short>::max())
@@ -32,18 +45,10 @@ Terrain::Terrain(unsigned width, unsigned depth, std::vector<float> heightmap)
     vertices.reserve((slicesWide + 1) * (slicesDeep + 1));
     indices.reserve(slicesWide * slicesDeep * 2 * 3);
 
-    float x_inc = 1.0f / slicesWide;
-    float z_inc = 1.0f / slicesDeep;
-
     // Calculate vertex positions, including the ends
     for (unsigned col = 0; col <= slicesWide; ++col) {
         for (unsigned row = 0; row <= slicesDeep; ++row) {
-            auto [pos, tx, tz] = bspline(col * x_inc, row * z_inc);
-
-            auto norm = glm::cross(tx, tz);
-            auto tex = glm::vec2{ pos.x, pos.z };
-
-            vertices.push_back({ pos, norm, tex });
+            vertices.push_back(surfaceVertex(col, row));
         }
     }
 
@@ -67,50 +72,98 @@ Terrain::Terrain(unsigned width, unsigned depth, std::vector<float> heightmap)
         }
     }
 
-    m_mesh.emplace(std::move(vertices), std::move(indices));
+    m_vertices = std::move(vertices);
+    m_mesh = std::make_shared<Mesh>(m_vertices, std::move(indices));
+    buildBounds();
+
+    // nothing is baked yet
+    m_unlit.assign(slicesWide + 1, true);
+    m_unoccluded.assign(slicesWide + 1, true);
+    m_stale.assign(slicesWide + 1, false);
 }
 
-float Terrain::altitude(float x, float z) const {
-    auto st = retrieveST(x, z);
-    auto [pos, tx, tz] = bspline(st.s, st.t);
+Vertex Terrain::surfaceVertex(unsigned col, unsigned row) const {
+    float x_inc = 1.0f / ((m_width - 1) * slices_per_tile);
+    float z_inc = 1.0f / ((m_depth - 1) * slices_per_tile);
+
+    auto [pos, tx, tz] = bspline(col * x_inc, row * z_inc);
+
+    auto norm = glm::cross(tz, tx); // upwards
+    auto tex = glm::vec2{ pos.x, pos.z };
+    auto weights = materialWeights(pos, glm::normalize(norm));
 
-    return pos.y;
+    // fully lit until baked
+    return { pos, norm, tex, weights, { 1, 1 } };
 }
 
-glm::vec2 Terrain::retrieveST(float x, float z) const {
-    auto& data = m_mesh->getVertices();
+void Terrain::submit(RenderQueue& queue, const Shader& program) const {
+    // nothing is culled, so the whole mesh is always one draw
+    queue.submit(program, m_materials.layers.get(), *m_mesh, 0, m_mesh->indexCount());
+}
 
-    auto different = [](float a, float b) { return std::fabsf(a - b) > 1e-5; };
+float Terrain::altitude(float x, float z) const {
+    SurfaceHint hint;
+    return altitude(x, z, hint);
+}
 
-    auto comp_x = [different](const Vertex& a, const Vertex& b) {
-        if (different(a.position.x, b.position.x))
-            return a.position.x < b.position.x;
-        return different(a.position.z, b.position.z) && a.position.z < b.position.z;
-    };
+float Terrain::altitude(float x, float z, SurfaceHint& hint) const {
+    auto st = retrieveST(x, z, hint);
+    return bsplineHeight(st.s, st.t, hint);
+}
 
-    auto comp_z = [different](const Vertex& a, const Vertex& b) {
-        return different(a.position.z, b.position.z) && a.position.z < b.position.z;
-    };
+namespace {
 
-#if DEBUG
-    if (!std::is_sorted(begin(data), end(data), comp_x))
-        throw std::runtime_error("Bad sort comp!");
-#endif
+    // The first of positions 1 .. count - 1 at or past `value', or the last
+    // if none are, where at(k) gives position k. Tries `hint' before searching.
+    template <typename At>
+    unsigned farCorner(unsigned hint, unsigned count, float value, At at) {
+        if (hint >= 1 && hint < count
+                && (hint == 1 || at(hint - 1) < value)
+                && (hint == count - 1 || value <= at(hint)))
+            return hint;
+
+        unsigned lo = 1;
+        unsigned hi = count - 1;
+        while (lo < hi) {
+            unsigned mid = (lo + hi) / 2;
+            if (at(mid) < value)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return lo;
+    }
+
+    // The k with knot[k] < t <= knot[k + 1], trying `hint' first
+    int knotSpan(int hint, const std::vector<float>& knot, float t) {
+        if (hint >= 0 && hint + 1 < static_cast<int>(knot.size())
+                && knot[hint] < t && t <= knot[hint + 1])
+            return hint;
+        return std::lower_bound(knot.begin(), knot.end(), t) - knot.begin() - 1;
+    }
+
+} // namespace
 
-    const auto datam_depth = (m_depth - 1) * slices_per_tile + 1;
+glm::vec2 Terrain::retrieveST(float x, float z, SurfaceHint& hint) const {
+    const unsigned cols = meshColumns();
+    const unsigned rows = meshRows();
 
-    // bounds checking
-    const auto firstIter = begin(data) + datam_depth + 1;
-    const auto lastIter  = end(data)   - datam_depth - 1;
+    // x only depends on s, so is the same down each column; likewise z
+    // along each row
+    auto col_x = [&](unsigned col) { return m_vertices[col * rows].position.x; };
+    auto row_z = [&](unsigned row) { return m_vertices[row].position.z; };
 
-    // get iter to point directly after given in both directions
-    Vertex value; value.position = { x, 0, z };
-    auto xIter   = std::lower_bound(firstIter, lastIter         , value, comp_x);
-    auto closest = std::lower_bound(xIter    , xIter + datam_depth, value, comp_z);
+#if DEBUG
+    for (unsigned col = 1; col < cols; ++col)
+        if (col_x(col) <= col_x(col - 1))
+            throw std::runtime_error("Mesh columns out of order!");
+    for (unsigned row = 1; row < rows; ++row)
+        if (row_z(row) <= row_z(row - 1))
+            throw std::runtime_error("Mesh rows out of order!");
+#endif
 
-    // recalculate the st used to generate this point
-    auto iterPos = std::distance(begin(data), closest);
-    glm::vec2 location = { iterPos / datam_depth, iterPos % datam_depth };
+    hint.col = farCorner(hint.col, cols, x, col_x);
+    hint.row = farCorner(hint.row, rows, z, row_z);
 
     glm::vec2 inc = {
         1.0f / ((m_width - 1) * slices_per_tile),
@@ -118,13 +171,12 @@ glm::vec2 Terrain::retrieveST(float x, float z) const {
     };
 
     glm::vec2 st0 = {
-        (location.s - 1) * inc.s,
-        (location.t - 1) * inc.t,
+        (hint.col - 1) * inc.s,
+        (hint.row - 1) * inc.t,
     };
 
-    const glm::vec3& current = closest->position;
-    const glm::vec3& previous =
-        data[(location.s - 1) * datam_depth + location.t - 1].position;
+    const glm::vec3& current = m_vertices[hint.col * rows + hint.row].position;
+    const glm::vec3& previous = m_vertices[(hint.col - 1) * rows + hint.row - 1].position;
 
     // lerp from previous to current point's st
     return glm::clamp(glm::vec2 {
@@ -133,6 +185,51 @@ glm::vec2 Terrain::retrieveST(float x, float z) const {
     }, 0.f, 1.f);
 }
 
+glm::vec4 Terrain::materialWeights(glm::vec3 position, glm::vec3 normal) const {
+    // 1 inside [lo, hi], ramping to 0 across a band of `material_blend'
+    // around each (finite) edge
+    auto within = [](float value, float lo, float hi) {
+        float above = std::isinf(lo) ? 1.f
+            : glm::clamp((value - lo) / material_blend + 0.5f, 0.f, 1.f);
+        float below = std::isinf(hi) ? 1.f
+            : glm::clamp((hi - value) / material_blend + 0.5f, 0.f, 1.f);
+        return above * below;
+    };
+
+    const float slope = 1 - std::fabs(normal.y);
+
+    glm::vec4 weights { 0 };
+    for (unsigned i = 0; i < m_materials.rules.size() && i < max_layers; ++i) {
+        const auto& rule = m_materials.rules[i];
+        weights[i] = within(position.y, rule.min_height, rule.max_height)
+                   * within(slope, rule.min_slope, rule.max_slope);
+    }
+
+    const auto& m = m_materials;
+    if (!m.splat.empty()) {
+        // bilinear lookup over the terrain's extent
+        float u = glm::clamp(position.x / (m_width - 1), 0.f, 1.f) * (m.splat_width - 1);
+        float v = glm::clamp(position.z / (m_depth - 1), 0.f, 1.f) * (m.splat_depth - 1);
+        unsigned u0 = static_cast<unsigned>(u);
+        unsigned v0 = static_cast<unsigned>(v);
+        unsigned u1 = std::min(u0 + 1, m.splat_width - 1);
+        unsigned v1 = std::min(v0 + 1, m.splat_depth - 1);
+        float fu = u - u0;
+        float fv = v - v0;
+
+        // painted weight adds to the rules, so it can bring in a layer
+        // they leave out
+        auto at = [&](unsigned a, unsigned b) { return m.splat[a * m.splat_depth + b]; };
+        weights = weights + glm::mix(glm::mix(at(u0, v0), at(u0, v1), fv),
+                                     glm::mix(at(u1, v0), at(u1, v1), fv), fu);
+    }
+
+    float total = weights.x + weights.y + weights.z + weights.w;
+    if (total <= 0)
+        return { 1, 0, 0, 0 };
+    return weights / total;
+}
+
 namespace {
     float bspline_coefficient(int m, int k, float t, const float* knot);
     float bspline_coefficient_derived(int m, int k, float t, const float* knot);
@@ -146,39 +243,43 @@ std::tuple<glm::vec3, glm::vec3, glm::vec3> Terrain::bspline(float s, float t) c
     glm::vec3 x_tangent { 0 };
     glm::vec3 z_tangent { 0 };
 
-    constexpr unsigned m = 3;
-
-    std::vector<float> knotW;
-    std::vector<float> knotH;
-    knotW.reserve(m + m_width + 1);
-    knotH.reserve(m + m_depth + 1);
+    constexpr int m = spline_degree;
+
+    // Only the m + 1 basis functions (and derivatives) of the knot span
+    // holding each parameter, knot[k] < s <= knot[k + 1], are non-zero
+    // there, so only those control points contribute.
+    const int ks = knotSpan(-1, m_knotW, s);
+    const int kt = knotSpan(-1, m_knotH, t);
+
+    float Ns[m + 1], dNs[m + 1];
+    float Nt[m + 1], dNt[m + 1];
+    for (int a = 0; a <= m; ++a) {
+        int i = ks - m + a;
+        int j = kt - m + a;
+        bool in_s = i >= 0 && i < static_cast<int>(m_width);
+        bool in_t = j >= 0 && j < static_cast<int>(m_depth);
+
+        Ns[a]  = in_s ? bspline_coefficient(m, i, s, m_knotW.data()) : 0;
+        dNs[a] = in_s ? bspline_coefficient_derived(m, i, s, m_knotW.data()) : 0;
+        Nt[a]  = in_t ? bspline_coefficient(m, j, t, m_knotH.data()) : 0;
+        dNt[a] = in_t ? bspline_coefficient_derived(m, j, t, m_knotH.data()) : 0;
+    }
 
-    for (unsigned k = 0; k < m; k++)
-        knotW.push_back(0);
-    for (unsigned k = m; k <= m_width; k++)
-        knotW.push_back(static_cast<float>(k - m) / (m_width - m));
-    for (unsigned k = 0; k < m; k++)
-        knotW.push_back(1);
+    for (int a = 0; a <= m; a++) {
+        unsigned i = ks - m + a;
+        if (i >= m_width)
+            continue;
 
-    for (unsigned k = 0; k < m; k++)
-        knotH.push_back(0);
-    for (unsigned k = m; k <= m_depth; k++)
-        knotH.push_back(static_cast<float>(k - m) / (m_depth - m));
-    for (unsigned k = 0; k < m; k++)
-        knotH.push_back(1);
+        for (int b = 0; b <= m; b++) {
+            unsigned j = kt - m + b;
+            if (j >= m_depth)
+                continue;
 
-    for (unsigned i = 0; i < m_width; i++) {
-        for (unsigned j = 0; j < m_depth; j++) {
             glm::vec3 control { i, m_heightmap[i * m_depth + j], j };
 
-            float P = bspline_coefficient(m, i, s, knotW.data()) *
-                      bspline_coefficient(m, j, t, knotH.data());
-
-            float S = bspline_coefficient_derived(m, i, s, knotW.data()) *
-                      bspline_coefficient(m, j, t, knotH.data());
-
-            float T = bspline_coefficient(m, i, s, knotW.data()) *
-                      bspline_coefficient_derived(m, j, t, knotH.data());
+            float P = Ns[a] * Nt[b];
+            float S = dNs[a] * Nt[b];
+            float T = Ns[a] * dNt[b];
 
             position  += P * control;
             x_tangent += S * control;
@@ -192,6 +293,596 @@ std::tuple<glm::vec3, glm::vec3, glm::vec3> Terrain::bspline(float s, float t) c
     return std::make_tuple(position, x_tangent, z_tangent);
 }
 
+float Terrain::bsplineHeight(float s, float t, SurfaceHint& hint) const {
+    if (s <= 0.f) s = 1e-10f;
+    if (t <= 0.f) t = 1e-10f;
+
+    constexpr int m = spline_degree;
+
+    hint.span_s = knotSpan(hint.span_s, m_knotW, s);
+    hint.span_t = knotSpan(hint.span_t, m_knotH, t);
+    const int ks = hint.span_s;
+    const int kt = hint.span_t;
+
+    float Ns[m + 1];
+    float Nt[m + 1];
+    for (int a = 0; a <= m; ++a) {
+        int i = ks - m + a;
+        int j = kt - m + a;
+        bool in_s = i >= 0 && i < static_cast<int>(m_width);
+        bool in_t = j >= 0 && j < static_cast<int>(m_depth);
+
+        Ns[a] = in_s ? bspline_coefficient(m, i, s, m_knotW.data()) : 0;
+        Nt[a] = in_t ? bspline_coefficient(m, j, t, m_knotH.data()) : 0;
+    }
+
+    float height = 0;
+    for (int a = 0; a <= m; a++) {
+        unsigned i = ks - m + a;
+        if (i >= m_width)
+            continue;
+
+        for (int b = 0; b <= m; b++) {
+            unsigned j = kt - m + b;
+            if (j >= m_depth)
+                continue;
+
+            height += Ns[a] * Nt[b] * m_heightmap[i * m_depth + j];
+        }
+    }
+    return height;
+}
+
+std::vector<float> Terrain::knots(unsigned count) {
+    constexpr unsigned m = spline_degree;
+
+    std::vector<float> knot;
+    knot.reserve(m + count + 1);
+
+    for (unsigned k = 0; k < m; k++)
+        knot.push_back(0);
+    for (unsigned k = m; k <= count; k++)
+        knot.push_back(static_cast<float>(k - m) / (count - m));
+    for (unsigned k = 0; k < m; k++)
+        knot.push_back(1);
+
+    return knot;
+}
+
+void Terrain::carve(const std::vector<Road>& roads) {
+    using namespace std::chrono;
+    auto start = high_resolution_clock::now();
+
+    // start again from the original ground
+    std::vector<unsigned> changed;
+    for (auto [index, height] : m_carved) {
+        m_heightmap[index] = height;
+        changed.push_back(index);
+    }
+    m_carved.clear();
+
+    // the strongest pull on each control point, from the nearest road sample
+    struct Pull { float weight = 0; float distance = 0; float height = 0; };
+    std::vector<Pull> pulls(m_heightmap.size());
+
+    for (const Road& road : roads) {
+        const std::vector<glm::vec2> centre = roadCentre(road);
+        const std::vector<float> ground = altitudes(centre);
+
+        // level out bumps along the road, too
+        const int samples = centre.size();
+        std::vector<float> target(samples);
+        for (int k = 0; k < samples; ++k) {
+            int lo = std::max(k - carve_smoothing, 0);
+            int hi = std::min(k + carve_smoothing, samples - 1);
+            float sum = 0;
+            for (int n = lo; n <= hi; ++n)
+                sum += ground[n];
+            target[k] = sum / (hi - lo + 1);
+        }
+
+        const float inner = road.width / 2 + carve_margin;
+        const float outer = inner + carve_blend;
+        for (int k = 0; k < samples; ++k) {
+            const glm::vec2 p = centre[k];
+            int i0 = std::max(0, static_cast<int>(std::ceil(p.x - outer)));
+            int i1 = std::min(static_cast<int>(m_width) - 1, static_cast<int>(std::floor(p.x + outer)));
+            int j0 = std::max(0, static_cast<int>(std::ceil(p.y - outer)));
+            int j1 = std::min(static_cast<int>(m_depth) - 1, static_cast<int>(std::floor(p.y + outer)));
+
+            for (int i = i0; i <= i1; ++i) {
+                for (int j = j0; j <= j1; ++j) {
+                    float d = glm::distance(p, glm::vec2(i, j));
+                    if (d >= outer)
+                        continue;
+
+                    float weight = 1 - glm::smoothstep(inner, outer, d);
+                    Pull& pull = pulls[i * m_depth + j];
+                    if (weight > pull.weight || (weight == pull.weight && d < pull.distance))
+                        pull = { weight, d, target[k] };
+                }
+            }
+        }
+    }
+
+    for (unsigned index = 0; index < pulls.size(); ++index) {
+        if (pulls[index].weight <= 0)
+            continue;
+        float& height = m_heightmap[index];
+        m_carved.emplace_back(index, height);
+        height = glm::mix(height, pulls[index].height, pulls[index].weight);
+        changed.push_back(index);
+    }
+
+    retessellate(changed);
+    buildBounds();
+    m_height_field.reset();
+
+    auto end = high_resolution_clock::now();
+    std::cout << "Carved " << roads.size() << " roads (" << m_carved.size()
+              << " control points) in " << duration<float>(end - start).count() << "s\n";
+}
+
+void Terrain::retessellate(const std::vector<unsigned>& controls) {
+    constexpr unsigned m = spline_degree;
+    const unsigned cols = meshColumns();
+    const unsigned rows = meshRows();
+
+    // the rows [first, last] to redo in each column; empty if first > last
+    std::vector<std::pair<unsigned, unsigned>> dirty(cols, { rows, 0 });
+
+    for (unsigned index : controls) {
+        unsigned i = index / m_depth;
+        unsigned j = index % m_depth;
+
+        // a control point only moves the surface over its basis function's
+        // support, from knot i to knot i + m + 1
+        unsigned col0 = std::floor(m_knotW[i] * (cols - 1));
+        unsigned col1 = std::min<unsigned>(std::ceil(m_knotW[i + m + 1] * (cols - 1)), cols - 1);
+        unsigned row0 = std::floor(m_knotH[j] * (rows - 1));
+        unsigned row1 = std::min<unsigned>(std::ceil(m_knotH[j + m + 1] * (rows - 1)), rows - 1);
+
+        for (unsigned col = col0; col <= col1; ++col) {
+            dirty[col].first = std::min(dirty[col].first, row0);
+            dirty[col].second = std::max(dirty[col].second, row1);
+            m_unlit[col] = m_unoccluded[col] = m_stale[col] = true;
+        }
+    }
+
+    // columns are disjoint, so threads never write the same vertex
+    parallelFor(cols, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t col = begin; col < end; ++col) {
+            auto [first, last] = dirty[col];
+            for (unsigned row = first; row <= last; ++row)
+                m_vertices[col * rows + row] = surfaceVertex(col, row);
+        }
+    });
+
+}
+
+const HeightPyramid& Terrain::heightField() {
+    if (m_height_field)
+        return *m_height_field;
+
+    const float step = 1.0f / light_resolution;
+    const unsigned grid_w = (m_width - 1) * light_resolution + 1;
+    const unsigned grid_d = (m_depth - 1) * light_resolution + 1;
+    std::vector<float> grid(grid_w * grid_d);
+
+    parallelFor(grid_w, [&](std::size_t begin, std::size_t end) {
+        std::vector<glm::vec2> points(grid_d);
+        for (std::size_t i = begin; i < end; ++i) {
+            for (unsigned j = 0; j < grid_d; ++j)
+                points[j] = { i * step, j * step };
+            auto heights = altitudes(points);
+            std::copy(heights.begin(), heights.end(), grid.begin() + i * grid_d);
+        }
+    });
+
+    return m_height_field.emplace(std::move(grid), grid_w, grid_d, step);
+}
+
+namespace {
+
+    // Mark every column up to `before' columns below, and `after' above, a
+    // marked one
+    std::vector<unsigned char> widen(const std::vector<unsigned char>& marked,
+            std::size_t before, std::size_t after)
+    {
+        std::vector<unsigned char> wide(marked.size(), false);
+        std::size_t left = 0;
+        for (std::size_t c = 0; c < marked.size(); ++c) {
+            if (marked[c])
+                left = std::min(after, marked.size()) + 1;
+            if (left) {
+                wide[c] = true;
+                --left;
+            }
+        }
+        left = 0;
+        for (std::size_t c = marked.size(); c-- > 0;) {
+            if (marked[c])
+                left = std::min(before, marked.size()) + 1;
+            if (left) {
+                wide[c] = true;
+                --left;
+            }
+        }
+        return wide;
+    }
+
+} // namespace
+
+std::pair<float, float> Terrain::heightRange() const {
+    // the surface stays within its control points, and carving only ever
+    // moves them between the original heights
+    auto [low, high] = std::minmax_element(m_heightmap.begin(), m_heightmap.end());
+    std::pair<float, float> range { *low, *high };
+    for (auto [index, height] : m_carved) {
+        range.first = std::min(range.first, height);
+        range.second = std::max(range.second, height);
+    }
+    return range;
+}
+
+void Terrain::bakeLighting(glm::vec3 sun) {
+    using namespace std::chrono;
+    auto start = high_resolution_clock::now();
+
+    const unsigned cols = meshColumns();
+    const unsigned rows = meshRows();
+
+    sun = glm::normalize(sun);
+    if (sun != m_sun)
+        m_unlit.assign(cols, true);
+    m_sun = sun;
+    if (std::find(m_unlit.begin(), m_unlit.end(), true) == m_unlit.end())
+        return;
+
+    const HeightPyramid& field = heightField();
+
+    // walk towards the sun, in steps along the ground
+    const glm::vec2 flat { sun.x, sun.z };
+    const float run = glm::length(flat);
+    const glm::vec2 towards = run > 1e-4f ? flat / run : glm::vec2 { 0 };
+    const float rise = run > 1e-4f ? sun.y / run : 0; // of the sun's rays, per unit
+    const float reach = glm::length(field.extent());
+
+    // Ground which moved can shade vertices away from the sun, but only as
+    // far off as a ray climbing at the shallowest rise that still shades can
+    // be blocked. A unit either side covers the height field's sampling.
+    float behind = 0;
+    if (sun.y > 0 && run > 1e-4f) {
+        auto [low, high] = heightRange();
+        const float shallowest = rise - penumbra;
+        behind = shallowest > 0 ? (high - low) / shallowest * std::fabs(towards.x) : reach;
+    }
+    const std::size_t shadow = std::ceil(std::min(behind, reach) * slices_per_tile);
+    const std::size_t margin = slices_per_tile;
+    const std::vector<unsigned char> redo = widen(m_unlit,
+            margin + (towards.x > 0 ? shadow : 0), margin + (towards.x < 0 ? shadow : 0));
+
+    parallelFor(cols, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t col = begin; col < end; ++col) {
+            if (!redo[col])
+                continue;
+
+            for (std::size_t v = col * rows; v < (col + 1) * rows; ++v) {
+                Vertex& vertex = m_vertices[v];
+
+                float lit = 1;
+                if (sun.y <= 0) {
+                    lit = 0;
+                } else if (run > 1e-4f) {
+                    // the steepest rise to the horizon, against that of the sun
+                    float horizon = field.horizon(vertex.position, towards, reach, rise + penumbra);
+                    lit = 1 - glm::smoothstep(rise - penumbra, rise + penumbra, horizon);
+                }
+
+                float diffuse = std::max(glm::dot(glm::normalize(vertex.normal), sun), 0.f);
+                vertex.light.x = diffuse * lit;
+            }
+            m_stale[col] = true;
+        }
+    });
+    m_unlit.assign(cols, false);
+
+    auto end = high_resolution_clock::now();
+    std::cout << "Baked terrain lighting (" << std::count(redo.begin(), redo.end(), true)
+              << " of " << cols << " columns) in " << duration<float>(end - start).count() << "s\n";
+}
+
+namespace {
+
+    constexpr std::uint32_t occlusion_magic = 0x4f414747; // "GGAO"
+
+} // namespace
+
+void Terrain::bakeOcclusion() {
+    using namespace std::chrono;
+    auto start = high_resolution_clock::now();
+
+    if (std::find(m_unoccluded.begin(), m_unoccluded.end(), true) == m_unoccluded.end())
+        return;
+
+    const unsigned cols = meshColumns();
+    const unsigned rows = meshRows();
+    const std::uint32_t count = m_vertices.size();
+
+    // a vertex only looks `occlusion_reach' away, plus a unit for sampling
+    const std::size_t margin = std::ceil((occlusion_reach + 1) * slices_per_tile);
+    const std::vector<unsigned char> redo = widen(m_unoccluded, margin, margin);
+    const std::size_t redone = std::count(redo.begin(), redo.end(), true);
+    m_unoccluded.assign(cols, false);
+
+    // anything which changes the result goes in the key
+    std::uint64_t h = hashBytes({ reinterpret_cast<const char*>(m_heightmap.data()),
+            m_heightmap.size() * sizeof(float) });
+    const std::uint32_t params[] = { m_width, m_depth, count, occlusion_rays, light_resolution };
+    h = hashBytes({ reinterpret_cast<const char*>(params), sizeof(params) }, h);
+    h = hashBytes({ reinterpret_cast<const char*>(&occlusion_reach), sizeof(occlusion_reach) }, h);
+    const std::string file = cacheFile("terrain", h, ".ao");
+
+    std::vector<float> open(count);
+    bool cached = false;
+    if (!file.empty()) {
+        std::ifstream in { file, std::ios::binary };
+        std::uint32_t header[2];
+        cached = in.read(reinterpret_cast<char*>(header), sizeof(header))
+            && header[0] == occlusion_magic && header[1] == count
+            && in.read(reinterpret_cast<char*>(open.data()), count * sizeof(float));
+    }
+
+    if (cached) {
+        for (unsigned col = 0; col < cols; ++col) {
+            if (!redo[col])
+                continue;
+            for (std::size_t v = col * rows; v < (col + 1) * rows; ++v)
+                m_vertices[v].light.y = open[v];
+            m_stale[col] = true;
+        }
+
+        auto end = high_resolution_clock::now();
+        std::cout << "Loaded terrain occlusion from " << file << " in "
+                  << duration<float>(end - start).count() << "s\n";
+        return;
+    }
+
+    const HeightPyramid& field = heightField();
+    auto traced = high_resolution_clock::now();
+
+    glm::vec2 directions[occlusion_rays];
+    for (unsigned r = 0; r < occlusion_rays; ++r) {
+        float angle = glm::two_pi<float>() * r / occlusion_rays;
+        directions[r] = { std::cos(angle), std::sin(angle) };
+    }
+
+    // each ray hides the sky below its horizon: the sine of its elevation
+    parallelFor(cols, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t col = begin; col < end; ++col) {
+            if (!redo[col])
+                continue;
+
+            for (std::size_t v = col * rows; v < (col + 1) * rows; ++v) {
+                float hidden = 0;
+                for (glm::vec2 dir : directions) {
+                    float t = field.horizon(m_vertices[v].position, dir, occlusion_reach);
+                    if (t > 0)
+                        hidden += t / std::sqrt(1 + t * t);
+                }
+                m_vertices[v].light.y = 1 - hidden / occlusion_rays;
+            }
+            m_stale[col] = true;
+        }
+    });
+
+    // the rest are still good, so the whole surface can be cached
+    if (!file.empty()) {
+        for (std::uint32_t v = 0; v < count; ++v)
+            open[v] = m_vertices[v].light.y;
+
+        std::uint32_t header[2] = { occlusion_magic, count };
+        std::ofstream out { file, std::ios::binary };
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(open.data()), count * sizeof(float));
+    }
+
+    auto end = high_resolution_clock::now();
+    const float seconds = duration<float>(end - traced).count();
+    const std::size_t rays = redone * rows * occlusion_rays;
+    std::cout << "Baked terrain occlusion (" << rays << " rays) in "
+              << duration<float>(end - start).count() << "s, "
+              << rays / seconds / 1e6f << "M rays/s\n";
+}
+
+void Terrain::upload() {
+    // one update for each run of neighbouring columns
+    const std::size_t rows = meshRows();
+    for (std::size_t col = 0; col < m_stale.size();) {
+        if (!m_stale[col]) {
+            ++col;
+            continue;
+        }
+        std::size_t end = col;
+        while (end < m_stale.size() && m_stale[end])
+            m_stale[end++] = false;
+        m_mesh->setVertices(col * rows, m_vertices.data() + col * rows, (end - col) * rows);
+        col = end;
+    }
+}
+
+std::vector<float> Terrain::altitudes(const std::vector<glm::vec2>& points) const {
+    std::vector<float> heights;
+    heights.reserve(points.size());
+    SurfaceHint hint;
+    for (glm::vec2 p : points)
+        heights.push_back(altitude(p.x, p.y, hint));
+    return heights;
+}
+
+void Terrain::buildBounds() {
+    constexpr unsigned m = spline_degree;
+
+    // x only depends on s, and z on t
+    m_spanX.clear();
+    for (unsigned k = m; k <= m_width; ++k)
+        m_spanX.push_back(std::get<0>(bspline(m_knotW[k], 0)).x);
+    m_spanZ.clear();
+    for (unsigned k = m; k <= m_depth; ++k)
+        m_spanZ.push_back(std::get<0>(bspline(0, m_knotH[k])).z);
+
+    // span (a, b) is a blend of control points a..a+m by b..b+m
+    const unsigned spans_wide = m_width - m;
+    const unsigned spans_deep = m_depth - m;
+    std::vector<float> lows(spans_wide * spans_deep);
+    std::vector<float> highs(spans_wide * spans_deep);
+    for (unsigned a = 0; a < spans_wide; ++a) {
+        for (unsigned b = 0; b < spans_deep; ++b) {
+            float low = std::numeric_limits<float>::infinity();
+            float high = -low;
+            for (unsigned i = a; i <= a + m; ++i) {
+                for (unsigned j = b; j <= b + m; ++j) {
+                    low = std::min(low, m_heightmap[i * m_depth + j]);
+                    high = std::max(high, m_heightmap[i * m_depth + j]);
+                }
+            }
+            lows[a * spans_deep + b] = low;
+            highs[a * spans_deep + b] = high;
+        }
+    }
+
+    m_bounds.emplace(spans_wide, spans_deep, std::move(lows), std::move(highs));
+}
+
+void Terrain::lineOfSight(const SightQueries& queries, std::vector<unsigned char>& visible,
+        bool threaded)
+{
+    render::lineOfSight(heightField(), queries, visible, threaded);
+}
+
+struct Terrain::Ray {
+    glm::vec3 origin;
+    glm::vec3 direction; // unit length
+    glm::vec3 inverse;   // of direction, per component
+
+    glm::vec3 at(float t) const { return origin + direction * t; }
+
+    // Narrow [t0, t1] to where the ray is inside the box [lo, hi]
+    bool clip(glm::vec3 lo, glm::vec3 hi, float& t0, float& t1) const {
+        for (int axis = 0; axis < 3; ++axis) {
+            if (direction[axis] == 0) {
+                if (origin[axis] < lo[axis] || origin[axis] > hi[axis])
+                    return false;
+                continue;
+            }
+            float near = (lo[axis] - origin[axis]) * inverse[axis];
+            float far = (hi[axis] - origin[axis]) * inverse[axis];
+            if (near > far)
+                std::swap(near, far);
+            t0 = std::max(t0, near);
+            t1 = std::min(t1, far);
+        }
+        return t0 <= t1;
+    }
+};
+
+bool Terrain::castCell(const Ray& ray, unsigned level, unsigned i, unsigned j,
+        float t0, float t1, float& hit) const
+{
+    const HeightPyramid& bounds = *m_bounds;
+    const unsigned a0 = i << level;
+    const unsigned b0 = j << level;
+    const unsigned a1 = std::min((i + 1) << level, bounds.width(0));
+    const unsigned b1 = std::min((j + 1) << level, bounds.depth(0));
+
+    const glm::vec3 lo { m_spanX[a0], bounds.lowest(level, i, j), m_spanZ[b0] };
+    const glm::vec3 hi { m_spanX[a1], bounds.highest(level, i, j), m_spanZ[b1] };
+    if (!ray.clip(lo, hi, t0, t1))
+        return false;
+
+    if (level > 0) {
+        // visit the children front to back; they don't overlap in x or z,
+        // so the first hit is the nearest
+        const unsigned below_width = bounds.width(level - 1);
+        const unsigned below_depth = bounds.depth(level - 1);
+        std::pair<float, unsigned> order[4];
+        unsigned children = 0;
+        for (unsigned ci = 2 * i; ci < std::min(2 * i + 2, below_width); ++ci) {
+            for (unsigned cj = 2 * j; cj < std::min(2 * j + 2, below_depth); ++cj) {
+                const unsigned ca = ci << (level - 1);
+                const unsigned cb = cj << (level - 1);
+                float c0 = t0;
+                float c1 = t1;
+                glm::vec3 clo { m_spanX[ca], lo.y, m_spanZ[cb] };
+                glm::vec3 chi { m_spanX[std::min(ca + (1u << (level - 1)), bounds.width(0))],
+                    hi.y, m_spanZ[std::min(cb + (1u << (level - 1)), bounds.depth(0))] };
+                if (ray.clip(clo, chi, c0, c1))
+                    order[children++] = { c0, ci * below_depth + cj };
+            }
+        }
+        std::sort(order, order + children);
+
+        for (unsigned c = 0; c < children; ++c) {
+            unsigned ci = order[c].second / below_depth;
+            unsigned cj = order[c].second % below_depth;
+            if (castCell(ray, level - 1, ci, cj, t0, t1, hit))
+                return true;
+        }
+        return false;
+    }
+
+    // within one patch: walk at the mesh's resolution to find where the ray
+    // first goes underground, then narrow it down
+    SurfaceHint hint;
+    auto below = [&](float t) {
+        glm::vec3 p = ray.at(t);
+        return p.y <= altitude(p.x, p.z, hint);
+    };
+
+    if (below(t0)) {
+        hit = t0;
+        return true;
+    }
+
+    const float run = glm::length(glm::vec2 { ray.direction.x, ray.direction.z });
+    const float step = run > 1e-6f ? 1.0f / slices_per_tile / run : t1 - t0;
+
+    float prev = t0;
+    while (prev < t1) {
+        float next = std::min(prev + step, t1);
+        if (below(next)) {
+            for (int k = 0; k < 16; ++k) {
+                float mid = (prev + next) / 2;
+                (below(mid) ? next : prev) = mid;
+            }
+            hit = next;
+            return true;
+        }
+        prev = next;
+    }
+    return false;
+}
+
+std::optional<glm::vec3> Terrain::raycast(glm::vec3 origin, glm::vec3 direction,
+        float reach) const
+{
+    Ray ray;
+    ray.origin = origin;
+    ray.direction = glm::normalize(direction);
+    ray.inverse = 1.0f / ray.direction;
+
+    // anywhere underground counts, not just under the patch bounds
+    const float x = glm::clamp(origin.x, m_spanX.front(), m_spanX.back());
+    const float z = glm::clamp(origin.z, m_spanZ.front(), m_spanZ.back());
+    if (x == origin.x && z == origin.z && origin.y <= altitude(x, z))
+        return origin;
+
+    float hit;
+    if (!castCell(ray, m_bounds->levels() - 1, 0, 0, 0, reach, hit))
+        return std::nullopt;
+    return ray.at(hit);
+}
+
 namespace {
 
     float bspline_coefficient(int m, int k, float t, const float* knot) {
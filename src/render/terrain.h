@@ -4,34 +4,184 @@
 #include <tuple>
 #include <vector>
 #include <optional>
+#include <memory>
+#include <limits>
 #include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
 
 #include "mesh.h"
 #include "texture.h"
+#include "shader.h"
+#include "render_queue.h"
+#include "roads.h"
+#include "height_pyramid.h"
+#include "line_of_sight.h"
 
 namespace render {
 
+// Where a layer of the terrain's texture array shows. Weights fade in and
+// out across the edges of each range.
+struct MaterialRule {
+    float min_height = -std::numeric_limits<float>::infinity();
+    float max_height = std::numeric_limits<float>::infinity();
+    float min_slope = 0; // 0 is flat, 1 is vertical
+    float max_slope = 1;
+};
+
+// What the terrain is covered with
+struct TerrainMaterials {
+    // an array texture, with a rule for each of its (up to four) layers
+    std::shared_ptr<const Texture> layers;
+    std::vector<MaterialRule> rules;
+
+    // optional weights for each layer (as RGBA), stretched over the whole
+    // terrain; stored with rows along x, like the heightmap
+    std::vector<glm::vec4> splat;
+    unsigned splat_width = 0;
+    unsigned splat_depth = 0;
+};
+
 class Terrain {
     static constexpr unsigned slices_per_tile = 16;
+    static constexpr float material_blend = 0.1f;
+    static constexpr unsigned spline_degree = 3;
+
+    // roads flatten the ground out to this far beyond their edges, then
+    // blend back over the next `carve_blend'
+    static constexpr float carve_margin = 0.5f;
+    static constexpr float carve_blend = 1.0f;
+    static constexpr int carve_smoothing = 5; // samples either side, along the road
+
+    // shadow rays step over a grid of heights this many times finer than
+    // the heightmap, and soften over this much rise per unit travelled
+    static constexpr unsigned light_resolution = 4;
+    static constexpr float penumbra = 0.05f;
+
+    // ambient occlusion looks for the horizon in this many directions around
+    // each vertex, out to this far
+    static constexpr unsigned occlusion_rays = 12;
+    static constexpr float occlusion_reach = 4.0f;
 
 public:
-    Terrain(unsigned width, unsigned depth, std::vector<float> heightmap);
+    static constexpr unsigned max_layers = 4;
 
-    void render() const { m_tex.use(); m_mesh->render(); }
+    Terrain(unsigned width, unsigned depth, std::vector<float> heightmap,
+            TerrainMaterials materials);
+
+    // Queue the terrain for drawing with `program'
+    void submit(RenderQueue& queue, const Shader& program) const;
+
+    // Height of the ground at (x, z), without allocating
     float altitude(float x, float z) const;
+
+    // Flatten the ground under `roads', undoing any previous call, and update
+    // the parts of the surface that moved
+    void carve(const std::vector<Road>& roads);
+
+    // Store the direct light from the sun in each vertex, shadowed by the
+    // terrain itself. After carve(), only the vertices whose shadows could
+    // have changed are redone.
+    void bakeLighting(glm::vec3 sun);
+
+    // Store how open the sky is above each vertex, for the ambient light.
+    // Results are cached on disk, keyed by the heightmap. After carve(), only
+    // the vertices within reach of the changes are redone.
+    void bakeOcclusion();
+
+    // Send every vertex changed since the last call to the mesh, in one go.
+    // Copies of the terrain share a mesh, so a copy can be carved and baked
+    // on another thread, then uploaded and swapped in on the GL thread.
+    void upload();
+
+    // Heights at many (x, z) points at once, quickest when neighbouring points
+    // are close together. Safe to call from several threads.
+    std::vector<float> altitudes(const std::vector<glm::vec2>& points) const;
+
+    // Where the ray from `origin' along `direction' first meets the ground,
+    // if it does within `reach' (a distance). A ray starting underground hits
+    // straight away.
+    std::optional<glm::vec3> raycast(glm::vec3 origin, glm::vec3 direction,
+            float reach = std::numeric_limits<float>::infinity()) const;
+
+    // Whether each pair of points can see each other over the ground; see
+    // render::lineOfSight(). Rays are checked against heightField().
+    void lineOfSight(const SightQueries& queries, std::vector<unsigned char>& visible,
+            bool threaded = true);
+
     auto size() const { return std::make_pair(m_width, m_depth); }
 
 private:
-    glm::vec2 retrieveST(float x, float z) const;
+    // Where the last height lookup landed: the mesh cell (by its far corner)
+    // and the knot spans. A lookup close by starts from there, and only
+    // searches again if it has moved on.
+    struct SurfaceHint {
+        unsigned col = 0;
+        unsigned row = 0;
+        int span_s = -1;
+        int span_t = -1;
+    };
+
+    float altitude(float x, float z, SurfaceHint& hint) const;
+    glm::vec2 retrieveST(float x, float z, SurfaceHint& hint) const;
     auto bspline(float s, float t) const
         -> std::tuple<glm::vec3, glm::vec3, glm::vec3>;
+    float bsplineHeight(float s, float t, SurfaceHint& hint) const; // without the tangents
+    glm::vec4 materialWeights(glm::vec3 position, glm::vec3 normal) const;
+
+    Vertex surfaceVertex(unsigned col, unsigned row) const;
+
+    unsigned meshColumns() const { return (m_width - 1) * slices_per_tile + 1; }
+    unsigned meshRows() const { return (m_depth - 1) * slices_per_tile + 1; }
+
+    // Lowest and highest the surface could be, carved or not
+    std::pair<float, float> heightRange() const;
+
+    // Heights sampled finely over a regular grid, for rays to walk. Built
+    // on first use after a change to the surface.
+    const HeightPyramid& heightField();
+
+    // Recompute the vertices which depend on the given control points, and
+    // mark the columns they lie in
+    void retessellate(const std::vector<unsigned>& controls);
+
+    // Clamped knot vector for `count' control points along one axis
+    static std::vector<float> knots(unsigned count);
+
+    // Rebuild m_bounds from the heightmap
+    void buildBounds();
+
+    // Find the nearest hit between `t0' and `t1' along a ray within cell
+    // (i, j) of m_bounds at `level'
+    struct Ray;
+    bool castCell(const Ray& ray, unsigned level, unsigned i, unsigned j,
+            float t0, float t1, float& hit) const;
 
     unsigned m_width;
     unsigned m_depth;
     std::vector<float> m_heightmap;
+    std::vector<float> m_knotW;
+    std::vector<float> m_knotH;
+    std::vector<std::pair<unsigned, float>> m_carved; // control point, original height
+
+    // The surface over each knot span lies within the lowest and highest of
+    // the control points it depends on. Level 0 of the pyramid holds those
+    // bounds for every span, with cells as wide as the spans.
+    std::optional<HeightPyramid> m_bounds; // delayed construction: should always exist
+    std::vector<float> m_spanX; // world positions of the knots between spans
+    std::vector<float> m_spanZ;
+
+    TerrainMaterials m_materials;
+    std::vector<Vertex> m_vertices; // column-major, as in the mesh
+    std::shared_ptr<Mesh> m_mesh; // between copies; only changed by upload()
 
-    Texture m_tex;
-    std::optional<Mesh> m_mesh; // delayed construction: should always exist
+    // for each column of the mesh, whether it moved since it was last baked,
+    // or uploaded
+    std::vector<unsigned char> m_unlit;
+    std::vector<unsigned char> m_unoccluded;
+    std::vector<unsigned char> m_stale;
+    glm::vec3 m_sun { 0 }; // as last baked
+    std::optional<HeightPyramid> m_height_field;
 };
 
 }
@@ -1,57 +1,266 @@
 #include "texture.h"
+#include "mipmaps.h"
+#include "extensions.h"
+#include "state.h"
 #include <glad/glad.h>
 #include <stb_image.h>
+
 #include <iostream>
+#include <stdexcept>
+#include <future>
+#include <vector>
+#include <chrono>
+#include <cstring>
+#include <utility>
 
 namespace render {
 
-void Texture::load(std::string file) {
+// The decode (or cache read) of the whole mip chain runs on a worker
+// thread, writing straight into a mapped pixel buffer; the GL thread then
+// only has to unmap it and issue the copies into the texture, which the
+// driver can do asynchronously.
+struct Texture::Upload {
+    std::vector<std::string> files; // one per layer
+    MipLayout layout;
+
+    unsigned pbo = 0;
+    std::vector<unsigned char> fallback; // if the buffer couldn't be mapped
+    std::future<bool> decoded;
+};
+
+Texture::Texture() = default;
+
+Texture::Texture(std::string file, TextureParams params) {
+    load(std::move(file), params);
+}
+
+Texture::Texture(std::vector<std::string> layers, TextureParams params) {
+    loadArray(std::move(layers), params);
+}
+
+void Texture::load(std::string file, TextureParams params) {
+    loadLayers({ std::move(file) }, params, GL_TEXTURE_2D);
+}
+
+void Texture::loadArray(std::vector<std::string> layers, TextureParams params) {
+    loadLayers(std::move(layers), params, GL_TEXTURE_2D_ARRAY);
+}
+
+void Texture::create(int width, int height, TextureParams params) {
     release();
 
-    int width;
-    int height;
-    int channels;
-    unsigned char* data = stbi_load(file.c_str(), &width, &height, &channels, 0);
-    if (!data) {
-        throw std::runtime_error("Could not load texture from \"" + file + "\"");
+    m_target = GL_TEXTURE_2D;
+    glGenTextures(1, &m_id);
+    state::bindTexture(m_target, m_id);
+
+    int wrap = params.repeat ? GL_REPEAT : GL_CLAMP_TO_EDGE;
+    glTexParameteri(m_target, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(m_target, GL_TEXTURE_WRAP_T, wrap);
+    glTexParameteri(m_target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(m_target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glTexImage2D(m_target, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(m_target, GL_TEXTURE_MAX_LEVEL, 0);
+
+    m_bytes = std::size_t(width) * height * 4 * 4 / 3; // with the mip chain
+}
+
+void Texture::generateMipmaps() const {
+    state::bindTexture(m_target, m_id);
+    glTexParameteri(m_target, GL_TEXTURE_MAX_LEVEL, 1000);
+    glGenerateMipmap(m_target);
+}
+
+void Texture::loadLayers(std::vector<std::string> files, TextureParams params, unsigned target) {
+    release();
+
+    if (files.empty())
+        throw std::runtime_error("No texture layers given");
+
+    // only read the headers for now
+    int width = 0;
+    int height = 0;
+    int channels = 3;
+    for (const auto& file : files) {
+        int w;
+        int h;
+        int c;
+        if (!stbi_info(file.c_str(), &w, &h, &c)) {
+            throw std::runtime_error("Could not load texture from \"" + file + "\"");
+        }
+        if (&file != &files.front() && (w != width || h != height)) {
+            throw std::runtime_error("Texture layer \"" + file + "\" differs in size");
+        }
+
+        width = w;
+        height = h;
+        if (c == 2 || c == 4)
+            channels = 4;
     }
+    const int layers = files.size();
 
+    m_target = target;
     glGenTextures(1, &m_id);
-    glBindTexture(GL_TEXTURE_2D, m_id);
+    state::bindTexture(m_target, m_id);
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    int mode = (channels == 4) ? GL_RGBA : GL_RGB;
-    glTexImage2D(GL_TEXTURE_2D, 0, mode, width, height, 0,
-                 mode, GL_UNSIGNED_BYTE, data);
+    int wrap = params.repeat ? GL_REPEAT : GL_CLAMP_TO_EDGE;
+    glTexParameteri(m_target, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(m_target, GL_TEXTURE_WRAP_T, wrap);
+    glTexParameteri(m_target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(m_target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
     if (GLAD_GL_EXT_texture_filter_anisotropic) {
         float size;
         glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &size);
-        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, size);
+        glTexParameterf(m_target, GL_TEXTURE_MAX_ANISOTROPY_EXT, size);
 
         std::cout << "Anisotropic filtering: " << size << "\n";
     }
 
-    glGenerateMipmap(GL_TEXTURE_2D);
+    // mid-grey placeholder until the real image arrives
+    const std::vector<unsigned char> placeholder(4 * layers, 128);
+    if (m_target == GL_TEXTURE_2D_ARRAY) {
+        glTexImage3D(m_target, 0, GL_RGBA, 1, 1, layers, 0,
+                GL_RGBA, GL_UNSIGNED_BYTE, placeholder.data());
+    } else {
+        glTexImage2D(m_target, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder.data());
+    }
+    glTexParameteri(m_target, GL_TEXTURE_MAX_LEVEL, 0);
+
+    m_pending = std::make_unique<Upload>();
+    m_pending->files = std::move(files);
+    m_pending->layout = mipLayout(width, height, channels,
+            params.compress && ext::texture_s3tc, layers);
 
-    stbi_image_free(data);
+    std::size_t size = m_pending->layout.size();
+    m_bytes = size;
+
+    glGenBuffers(1, &m_pending->pbo);
+    state::bindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pending->pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    state::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (!dst) {
+        state::deleteBuffer(m_pending->pbo);
+        m_pending->pbo = 0;
+        m_pending->fallback.resize(size);
+        dst = m_pending->fallback.data();
+    }
+
+    m_pending->decoded = std::async(std::launch::async,
+        [files = m_pending->files, layout = m_pending->layout, dst]() {
+            bool success = true;
+            for (int layer = 0; layer < layout.layers; ++layer) {
+                success = loadMips(files[layer], layout, static_cast<unsigned char*>(dst), layer)
+                       && success;
+            }
+            return success;
+        });
+}
+
+void Texture::finishUpload() const {
+    Upload& upload = *m_pending;
+    bool decoded = upload.decoded.get();
+
+    state::bindTexture(m_target, m_id);
+
+    const void* pixels = upload.fallback.data();
+    if (upload.pbo) {
+        state::bindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.pbo);
+        decoded = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) && decoded;
+        pixels = nullptr; // offset into the buffer
+    }
+
+    if (decoded) {
+        const MipLayout& layout = upload.layout;
+        int mode = (layout.channels == 4) ? GL_RGBA : GL_RGB;
+        auto base = static_cast<const unsigned char*>(pixels);
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (int level = 0; level < layout.levels(); ++level) {
+            const void* data = base + layout.offsets[level];
+            int w = layout.levelWidth(level);
+            int h = layout.levelHeight(level);
+
+            if (m_target == GL_TEXTURE_2D_ARRAY && layout.format) {
+                glCompressedTexImage3D(m_target, level, layout.format, w, h, layout.layers, 0,
+                        layout.levelSize(level), data);
+            } else if (m_target == GL_TEXTURE_2D_ARRAY) {
+                glTexImage3D(m_target, level, mode, w, h, layout.layers, 0,
+                        mode, GL_UNSIGNED_BYTE, data);
+            } else if (layout.format) {
+                glCompressedTexImage2D(m_target, level, layout.format, w, h, 0,
+                        layout.levelSize(level), data);
+            } else {
+                glTexImage2D(m_target, level, mode, w, h, 0, mode, GL_UNSIGNED_BYTE, data);
+            }
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(m_target, GL_TEXTURE_MAX_LEVEL, layout.levels() - 1);
+    } else {
+        std::cerr << "Could not load texture from \"" << upload.files.front() << "\"";
+        for (std::size_t i = 1; i < upload.files.size(); ++i)
+            std::cerr << ", \"" << upload.files[i] << "\"";
+        std::cerr << std::endl;
+    }
+
+    if (upload.pbo) {
+        state::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        state::deleteBuffer(upload.pbo);
+    }
+
+    m_pending.reset();
+}
+
+Texture::~Texture() {
+    release();
+}
+
+Texture::Texture(Texture&& other)
+    : m_id { std::exchange(other.m_id, 0) }
+    , m_target { other.m_target }
+    , m_bytes { std::exchange(other.m_bytes, 0) }
+    , m_pending { std::move(other.m_pending) }
+{
+}
+
+Texture& Texture::operator=(Texture&& other) {
+    std::swap(m_id, other.m_id);
+    std::swap(m_target, other.m_target);
+    std::swap(m_bytes, other.m_bytes);
+    std::swap(m_pending, other.m_pending);
+    return *this;
 }
 
 void Texture::release() {
+    if (m_pending) {
+        // the worker may still be writing into the buffer
+        m_pending->decoded.wait();
+        if (m_pending->pbo) {
+            state::bindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pending->pbo);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            state::bindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            state::deleteBuffer(m_pending->pbo);
+        }
+        m_pending.reset();
+    }
+
     if (m_id) {
-        glDeleteTextures(1, &m_id);
+        state::deleteTexture(m_id);
         m_id = 0;
+        m_bytes = 0;
     }
 }
 
-void Texture::use(int texUnit /* = -1 */) const {
-    if (texUnit >= 0)
-        glActiveTexture(GL_TEXTURE0 + texUnit);
-    glBindTexture(GL_TEXTURE_2D, m_id);
+void Texture::use(int texUnit /* = 0 */) const {
+    using namespace std::chrono_literals;
+
+    // on our unit first, as finishing the upload binds to the active one
+    state::bindTexture(m_target, m_id, texUnit);
+    if (m_pending && m_pending->decoded.wait_for(0s) == std::future_status::ready)
+        finishUpload();
 }
 
 }
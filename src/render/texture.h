@@ -2,33 +2,76 @@
 #define RENDER_TEXTURE_H_INCLUDED
 
 #include <string>
+#include <vector>
+#include <memory>
+#include <cstddef>
 
 namespace render {
 
+// How a texture is sampled and stored
+struct TextureParams {
+    bool repeat = true;   // wrap, rather than clamp to the edge
+    bool compress = true; // store S3TC-compressed where supported
+
+    bool operator==(const TextureParams& other) const {
+        return repeat == other.repeat && compress == other.compress;
+    }
+};
+
 class Texture {
 public:
     // creation
-    Texture() = default;
-    Texture(std::string file) { load(std::move(file)); }
-    void load(std::string file);
+    Texture();
+    Texture(std::string file, TextureParams params = {});
+    Texture(std::vector<std::string> layers, TextureParams params = {});
+
+    // Start loading `file' in the background. The texture can be used
+    // straight away: it shows a flat placeholder until the image has been
+    // decoded, at which point the next use() uploads it.
+    // Throws std::runtime_error if `file' isn't a readable image.
+    void load(std::string file, TextureParams params = {});
+
+    // Likewise, but make an array texture with one layer per file. The
+    // images must all be the same size.
+    void loadArray(std::vector<std::string> layers, TextureParams params = {});
+
+    // Allocate a blank RGBA image to render into. Call generateMipmaps()
+    // once it has been drawn.
+    void create(int width, int height, TextureParams params = {});
+    void generateMipmaps() const;
+
+    // has the image been uploaded yet?
+    bool ready() const { return !m_pending; }
+
+    // video memory taken by the full image, once uploaded
+    std::size_t bytes() const { return m_bytes; }
 
     // deletion
-    ~Texture() { release(); }
+    ~Texture();
     void release();
 
     // only moving
-    Texture(Texture&& other) : m_id { other.m_id } { other.m_id = 0; }
-    Texture& operator=(Texture&& other) { std::swap(m_id, other.m_id); return *this; }
+    Texture(Texture&& other);
+    Texture& operator=(Texture&& other);
 
     // get the GL id directly
     unsigned get() const { return m_id; }
+    unsigned target() const { return m_target; }
     operator unsigned() const { return m_id; }
 
-    // use it
-    void use(int texUnit = -1) const;
+    // use it, on texture unit `texUnit'
+    void use(int texUnit = 0) const;
 
 private:
+    struct Upload; // an image still being decoded
+
     unsigned m_id = 0;
+    unsigned m_target = 0x0DE1; // GL_TEXTURE_2D
+    std::size_t m_bytes = 0;
+    mutable std::unique_ptr<Upload> m_pending;
+
+    void loadLayers(std::vector<std::string> files, TextureParams params, unsigned target);
+    void finishUpload() const;
 };
 
 }
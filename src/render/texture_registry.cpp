@@ -0,0 +1,74 @@
+#include "texture_registry.h"
+
+#include <algorithm>
+
+namespace render {
+
+TextureRegistry::TextureRegistry(std::size_t budget)
+    : m_entries { }
+    , m_budget { budget }
+    , m_clock { 0 }
+{
+}
+
+std::shared_ptr<const Texture> TextureRegistry::acquire(const std::string& file, TextureParams params) {
+    return acquire(std::vector<std::string> { file }, false, params);
+}
+
+std::shared_ptr<const Texture> TextureRegistry::acquireArray(const std::vector<std::string>& layers,
+        TextureParams params)
+{
+    return acquire(layers, true, params);
+}
+
+std::shared_ptr<const Texture> TextureRegistry::acquire(const std::vector<std::string>& files,
+        bool array, TextureParams params)
+{
+    ++m_clock;
+
+    auto it = std::find_if(m_entries.begin(), m_entries.end(), [&](const Entry& e) {
+        return e.files == files && e.array == array && e.params == params;
+    });
+    if (it != m_entries.end()) {
+        it->last_used = m_clock;
+        return it->texture;
+    }
+
+    auto texture = array ? std::make_shared<Texture>(files, params)
+                         : std::make_shared<Texture>(files.front(), params);
+    m_entries.push_back({ files, array, params, texture, m_clock });
+    trim();
+
+    return texture;
+}
+
+std::size_t TextureRegistry::resident() const {
+    std::size_t total = 0;
+    for (const auto& entry : m_entries)
+        total += entry.texture->bytes();
+    return total;
+}
+
+void TextureRegistry::trim() {
+    // anything still referenced counts as used now, so unreferenced entries
+    // are left ordered by roughly when they were last needed
+    for (auto& entry : m_entries)
+        if (entry.texture.use_count() > 1)
+            entry.last_used = m_clock;
+
+    std::sort(m_entries.begin(), m_entries.end(), [](const Entry& a, const Entry& b) {
+        return a.last_used < b.last_used;
+    });
+
+    std::size_t total = resident();
+    for (auto it = m_entries.begin(); it != m_entries.end() && total > m_budget; ) {
+        if (it->texture.use_count() == 1) {
+            total -= it->texture->bytes();
+            it = m_entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+}
@@ -0,0 +1,62 @@
+#ifndef RENDER_TEXTURE_REGISTRY_H_INCLUDED
+#define RENDER_TEXTURE_REGISTRY_H_INCLUDED
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+#include "texture.h"
+
+namespace render {
+
+// Hands out shared textures, loading each file (with given parameters) only
+// once. Textures nobody holds a handle to any more are kept around for
+// reuse, until the total exceeds the video memory budget; then they are
+// released, least recently used first.
+class TextureRegistry {
+public:
+    explicit TextureRegistry(std::size_t budget = 256 << 20);
+
+    TextureRegistry(const TextureRegistry& other) = delete;
+    TextureRegistry& operator=(const TextureRegistry& other) = delete;
+
+    // Get the texture for `file', loading it if needed.
+    // Throws std::runtime_error if `file' isn't a readable image.
+    std::shared_ptr<const Texture> acquire(const std::string& file, TextureParams params = {});
+
+    // Likewise for an array texture made of `layers'
+    std::shared_ptr<const Texture> acquireArray(const std::vector<std::string>& layers,
+            TextureParams params = {});
+
+    // Change the budget (in bytes), evicting as necessary
+    void setBudget(std::size_t bytes) { m_budget = bytes; trim(); }
+    std::size_t budget() const { return m_budget; }
+
+    // Bytes used by every texture we hold, referenced or not
+    std::size_t resident() const;
+
+    // Release unreferenced textures until we fit in the budget
+    void trim();
+
+private:
+    struct Entry {
+        std::vector<std::string> files;
+        bool array;
+        TextureParams params;
+        std::shared_ptr<Texture> texture;
+        std::uint64_t last_used;
+    };
+
+    std::vector<Entry> m_entries;
+    std::size_t m_budget;
+    std::uint64_t m_clock;
+
+    std::shared_ptr<const Texture> acquire(const std::vector<std::string>& files, bool array,
+            TextureParams params);
+};
+
+}
+
+#endif
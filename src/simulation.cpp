@@ -0,0 +1,84 @@
+#include "simulation.h"
+#include "level.h"
+#include "alloc_count.h"
+
+#include <glm/glm.hpp>
+
+namespace world {
+
+namespace {
+
+    using clock = std::chrono::steady_clock;
+
+    // how far the simulation may fall behind before giving up on catching up
+    constexpr std::chrono::milliseconds max_lag { 250 };
+
+} // namespace
+
+Simulation::Simulation(const Level& level, double step_rate)
+    : Simulation { level, step_rate, level.startingCamera() }
+{ }
+
+Simulation::Simulation(const Level& level, double step_rate, const Camera& start)
+    : m_level { level }
+    , m_step { 1 / step_rate }
+    , m_running { true }
+    , m_controls { }
+    , m_snapshots { Snapshot { start, clock::now() } }
+    , m_thread { &Simulation::run, this, start }
+{ }
+
+Simulation::~Simulation() {
+    m_running.store(false, std::memory_order_relaxed);
+    m_thread.join();
+}
+
+void Simulation::control(const Controls& controls) {
+    m_controls.back() = controls;
+    m_controls.publish();
+}
+
+const Snapshot& Simulation::latest() {
+    return m_snapshots.read();
+}
+
+float Simulation::blend(const Snapshot& snapshot, clock::time_point now) const {
+    // steps are published as soon as they're done, ahead of their time
+    std::chrono::duration<double> ahead = snapshot.time - now;
+    return glm::clamp(1 - ahead / m_step, 0.0, 1.0);
+}
+
+void Simulation::step(Camera& camera, clock::time_point time) {
+    const Controls& controls = m_controls.read();
+    camera.turnTo(controls.look);
+    camera.settle();
+    m_level.walk(camera, controls.steer, m_step.count());
+
+    Snapshot& snapshot = m_snapshots.back();
+    snapshot.camera = camera;
+    snapshot.time = time;
+    snapshot.input_time = controls.input_time;
+    m_snapshots.publish();
+}
+
+void Simulation::run(Camera camera) {
+    const auto period = std::chrono::duration_cast<clock::duration>(m_step);
+    auto next = clock::now();
+
+    while (m_running.load(std::memory_order_relaxed)) {
+        next += period;
+
+        const std::size_t before = allocations();
+        step(camera, next);
+        m_step_allocations.fetch_add(allocations() - before, std::memory_order_relaxed);
+        m_steps.fetch_add(1, std::memory_order_relaxed);
+
+        // after a hitch, slow down rather than jump ahead
+        auto now = clock::now();
+        if (now - next > max_lag)
+            next = now;
+        std::this_thread::sleep_until(next);
+    }
+}
+
+}
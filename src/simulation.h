@@ -0,0 +1,78 @@
+#ifndef SIMULATION_H_INCLUDED
+#define SIMULATION_H_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <glm/vec2.hpp>
+
+#include "camera.h"
+#include "triple_buffer.h"
+
+namespace world {
+
+class Level;
+
+// What the player is asking for, as of the latest frame
+struct Controls {
+    glm::vec2 steer { 0, 0 }; // forwards, rightwards
+    Camera look;              // only its facing is used
+    double input_time = 0;    // when they were read, on the caller's clock
+};
+
+// The simulation after a step, for drawing
+struct Snapshot {
+    Camera camera; // blends from the step before
+    std::chrono::steady_clock::time_point time;
+    double input_time = 0; // of the controls it used; 0 before any
+};
+
+// Runs the level's simulation at a fixed rate on its own thread, so that slow
+// steps never hold up drawing. Input goes in, and results come out, through
+// triple buffers; the GL thread never waits on the simulation.
+class Simulation {
+public:
+    // Starts stepping straight away. `level' must outlive this.
+    Simulation(const Level& level, double step_rate);
+    ~Simulation();
+
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+
+    // GL thread only: replace the controls used for the next steps
+    void control(const Controls& controls);
+
+    // GL thread only: the newest step finished, and how far (from 0 to 1) to
+    // blend towards it from the one before at `now'
+    const Snapshot& latest();
+    float blend(const Snapshot& snapshot, std::chrono::steady_clock::time_point now) const;
+
+    // Steps taken so far, and how many allocations they made between them
+    // (only counted when built with CHECK_ALLOC; see alloc_count.h)
+    unsigned steps() const { return m_steps.load(std::memory_order_relaxed); }
+    std::size_t stepAllocations() const { return m_step_allocations.load(std::memory_order_relaxed); }
+
+private:
+    Simulation(const Level& level, double step_rate, const Camera& start);
+
+    void run(Camera camera);
+
+    // Move `camera' on by one step under the latest controls, and publish
+    // the result as due at `time'
+    void step(Camera& camera, std::chrono::steady_clock::time_point time);
+
+    const Level& m_level;
+    const std::chrono::duration<double> m_step;
+    std::atomic<bool> m_running;
+    std::atomic<unsigned> m_steps { 0 };
+    std::atomic<std::size_t> m_step_allocations { 0 };
+
+    TripleBuffer<Controls> m_controls;
+    TripleBuffer<Snapshot> m_snapshots;
+    std::thread m_thread; // last, so everything is ready before it starts
+};
+
+}
+
+#endif
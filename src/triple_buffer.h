@@ -0,0 +1,46 @@
+#ifndef TRIPLE_BUFFER_H_INCLUDED
+#define TRIPLE_BUFFER_H_INCLUDED
+
+#include <atomic>
+
+namespace world {
+
+// Hands the latest value from one writer thread to one reader thread without
+// locking. The writer fills back() then publish()es it; the reader's read()
+// gives the newest published value, skipping any it missed. Neither side
+// ever waits for the other.
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() = default;
+    TripleBuffer(const T& initial) : m_slots { initial, initial, initial } {}
+
+    // Writer only: the slot to fill in next
+    T& back() { return m_slots[m_back]; }
+
+    // Writer only: make back() the newest value, and get a new back()
+    void publish() {
+        m_back = m_middle.exchange(m_back | fresh, std::memory_order_acq_rel) & index;
+    }
+
+    // Reader only: the newest value published, or the last one read if
+    // nothing has been since. Stays valid until the next call.
+    const T& read() {
+        if (m_middle.load(std::memory_order_relaxed) & fresh)
+            m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & index;
+        return m_slots[m_front];
+    }
+
+private:
+    static constexpr unsigned index = 3;
+    static constexpr unsigned fresh = 4; // set while the middle slot is unread
+
+    T m_slots[3];
+    unsigned m_back = 0;
+    std::atomic<unsigned> m_middle { 1 };
+    unsigned m_front = 2;
+};
+
+}
+
+#endif